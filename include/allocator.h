@@ -10,5 +10,6 @@ struct HNetAllocator
     void(*no_memory)();
 };
 
+void hnet_allocator_set(const HNetAllocator& callbacks);
 void* hnet_malloc(size_t size);
 void hnet_free(void* ptr);
\ No newline at end of file
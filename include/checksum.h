@@ -0,0 +1,16 @@
+#pragma once
+
+#include "types.h"
+
+enum class HNetCrc32cImpl : uint8_t
+{
+    Slicing8,
+    Sse42,
+    Pclmul,
+};
+
+// CRC32C (Castagnoli) over the buffers in order, in network byte order; fits HNetChecksumCallback
+uint32_t hnet_crc32c(const HNetBuffer* pBuffers, size_t bufferCount);
+uint32_t hnet_crc32c_with(HNetCrc32cImpl impl, const HNetBuffer* pBuffers, size_t bufferCount);
+bool hnet_crc32c_supported(HNetCrc32cImpl impl);
+HNetCrc32cImpl hnet_crc32c_best_impl();
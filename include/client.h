@@ -12,7 +12,7 @@ public:
     static void destroy(HNetClient*& client);
 
     bool connect(const char* pHostName, uint16_t port);
-    void update();
+    void update(uint32_t timeout = 0);
     void sendPacket();
 
 private:
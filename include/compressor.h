@@ -2,10 +2,19 @@
 
 #include "types.h"
 
+#define HNET_LZ_WINDOW_SIZE 4096
+#define HNET_LZ_HASH_BITS   12
+
 struct HNetCompressor
 {
     void* context;
     size_t (*compress)(void* context, const HNetBuffer* inBuffers, size_t inBufferCount, size_t inLimit, uint8_t* outData, size_t outLimit);
     size_t (*decompress)(void* context, const uint8_t* inData, size_t inLimit, uint8_t* outData, size_t outLimit);
     void (*destroy)(void* context);
-};
\ No newline at end of file
+};
+
+// built-in LZ77 codec; one datagram per call, the context only holds the match window and hash table
+void* hnet_lz_create();
+void hnet_lz_destroy(void* context);
+size_t hnet_lz_compress(void* context, const HNetBuffer* inBuffers, size_t inBufferCount, size_t inLimit, uint8_t* outData, size_t outLimit);
+size_t hnet_lz_decompress(void* context, const uint8_t* inData, size_t inLimit, uint8_t* outData, size_t outLimit);
@@ -17,6 +17,8 @@ struct HNetEvent
 {
     HNetEventType type;
     HNetPeer* peer;
+    // the session the event belongs to, kept after a disconnect resets the peer
+    uint32_t connectId;
     uint8_t channelId;
     uint32_t data;
     HNetPacket* packet;
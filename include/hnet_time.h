@@ -9,5 +9,9 @@
 #define HNET_TIME_GE(a, b) (!HNET_TIME_LT(a, b))
 #define HNET_TIME_DIFF(a, b) ((a) - (b) >= HNET_TIME_OVERFLOW ? (b) - (a) : (a) - (b))
 
+// monotonic, coarse-grained (a few ms at most) and cheap enough to call once per service iteration
 uint64_t hnet_time_now_msec();
+// monotonic, microsecond resolution
+uint64_t hnet_time_now_usec();
+// wall clock
 uint64_t hnet_time_now_sec();
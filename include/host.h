@@ -2,7 +2,9 @@
 
 #include "compressor.h"
 #include "list.h"
+#include "pool.h"
 #include "protocol.h"
+#include "ring.h"
 #include "socket.h"
 #include "types.h"
 
@@ -16,14 +18,63 @@ struct HNetPeer;
 #define HNET_HOST_DEFAULT_MTU                 1400
 #define HNET_HOST_DEFAULT_MAX_PACKET_SIZE     (32 * 1024 * 1024)
 #define HNET_HOST_DEFAULT_MAX_WAITING_DATA    (32 * 1024 * 1024)
+#define HNET_HOST_DEFAULT_MAX_FRAGMENT_DATA   (1024 * 1024)
+#define HNET_HOST_DEFAULT_RECV_BATCH_SIZE     32
+#define HNET_HOST_DEFAULT_SEND_BATCH_SIZE     32
+#define HNET_HOST_ZERO_COPY_THRESHOLD         256
+#define HNET_HOST_MIN_PEER_BUCKETS            16
+#define HNET_HOST_MAX_SHARDS                  64
+#define HNET_HOST_ASYNC_SEND_QUEUE_SIZE       4096
 #define HNET_BUFFER_MAX                       (1 + 2 * HNET_PROTOCOL_MAX_PACKET_COMMANDS)
 
+struct HNetPacket;
+
+struct HNetRecvBuffer
+{
+    HNetPacket* packet;
+    size_t dataLength;
+    HNetAddr addr;
+};
+
+// number of indexed peers sharing one remote host, keyed by the host alone (port ignored)
+struct HNetHostCount
+{
+    HNetAddr addr;
+    size_t count;
+};
+
+struct HNetSendBuffer
+{
+    uint8_t headerData[sizeof(HNetProtocolHeader) + sizeof(uint32_t)];
+    HNetProtocol commands[HNET_PROTOCOL_MAX_PACKET_COMMANDS];
+    HNetBuffer buffers[HNET_BUFFER_MAX];
+    size_t bufferCount;
+    HNetPeer* peer;
+    uint8_t packetData[HNET_PROTOCOL_MAX_MTU];
+};
+
+// names the peer by id and session so a send that outlives the connection is dropped rather than
+// delivered to whichever peer reuses the slot
+struct HNetAsyncSend
+{
+    HNetPacket* packet;
+    uint32_t connectId;
+    uint16_t peerId;
+    uint8_t channelId;
+};
+
 using HNetChecksumCallback = uint32_t(*)(const HNetBuffer* pBuffers, size_t bufferCount);
+// sees every datagram (host.recvData/recvDataLength/recvAddr) before it is matched to a peer;
+// returns 1 if it consumed the datagram (optionally filling the event), -1 on error, 0 to process it normally
 using HNetInterceptCallback = int32_t(*)(HNetHost* pHost, HNetEvent* pEvent);
+// returns the current time in milliseconds; lets simulations drive a host on virtual time. With a clock set,
+// service never blocks: a timeout only makes it poll the socket once more, as virtual time cannot be waited out
+using HNetClockCallback = uint32_t(*)(HNetHost* pHost);
 
 struct HNetHost
 {
     HNetSocket socket;
+    HNetSocket wakeup;
     HNetAddr addr;
     uint32_t incomingBandwidth;
     uint32_t outgoingBandwidth;
@@ -33,37 +84,105 @@ struct HNetHost
     bool recalculateBandwidthLimits;
     HNetPeer* peers;
     size_t peerCount;
+    HNetPeer** freePeers;
+    size_t freePeerCount;
+    HNetPeer** peerTimers;
+    size_t peerTimerCount;
+    HNetPeer** peerBuckets;
+    HNetHostCount* hostCounts;
+    size_t peerBucketMask;
+    uint16_t shardIndex;
+    uint8_t shardBits;
     size_t channelLimit;
     uint32_t serviceTime;
     HNetList dispatchQueue;
+    HNetList sendQueue;
     bool continueSending;
     size_t packetSize;
     uint16_t headerFlags;
-    HNetProtocol commands[HNET_PROTOCOL_MAX_PACKET_COMMANDS];
+    HNetProtocol* commands;
     size_t commandCount;
-    HNetBuffer buffers[HNET_BUFFER_MAX];
+    HNetBuffer* buffers;
     size_t bufferCount;
+    HNetSendBuffer* sendBuffers;
+    size_t sendBatchSize;
+    size_t sendBatchCount;
+    uint32_t totalSendBatches;
+    uint32_t totalSendBatchPackets;
     HNetChecksumCallback checksum;
     HNetCompressor compressor;
+    uint64_t totalCompressInput;
+    uint64_t totalCompressOutput;
+    uint64_t compressTime;
+    uint64_t decompressTime;
     uint8_t packetData[2][HNET_PROTOCOL_MAX_MTU];
     HNetAddr recvAddr;
     uint8_t* recvData;
     size_t recvDataLength;
+    HNetPacket* recvPacket;
+    HNetRecvBuffer* recvBuffers;
+    size_t recvBatchSize;
+    size_t recvBatchCount;
+    size_t recvBatchIndex;
+    uint32_t totalRecvBatches;
+    uint32_t totalRecvBatchPackets;
     uint32_t totalSentData;
     uint32_t totalSentPackets;
     uint32_t totalRecvData;
     uint32_t totalRecvPackets;
     HNetInterceptCallback intercept;
+    HNetPool outgoingCommandPool;
+    HNetPool incomingCommandPool;
+    HNetPool ackPool;
+    HNetMpscRing<HNetAsyncSend> asyncSends;
+    HNetClockCallback clock;
+    bool selectiveAcks;
     size_t connectedPeers;
     size_t bandwidthLimitedPeers;
     size_t duplicatePeers;
     size_t maxPacketSize;
     size_t maxWaitingData;
+    size_t maxUnreliableFragmentData;
 };
 
-bool hnet_host_initialize(HNetHost& host, HNetAddr* pAddr, size_t peerCount, size_t channelLimit, uint32_t incomingBandwidth, uint32_t outgoingBandwidth);
+bool hnet_host_initialize(HNetHost& host, HNetAddr* pAddr, size_t peerCount, size_t channelLimit, uint32_t incomingBandwidth, uint32_t outgoingBandwidth, size_t reservedCommands = 0);
+// binds shardCount hosts (a power of two) to one port with SO_REUSEPORT, each to be serviced on its own thread;
+// peer ids carry the shard in their low bits and the kernel steers every datagram to the host owning its peer.
+// peerCount is per shard, addr receives the bound port
+bool hnet_host_initialize_shards(HNetHost* pHosts, size_t shardCount, HNetAddr& addr, size_t peerCount, size_t channelLimit, uint32_t incomingBandwidth, uint32_t outgoingBandwidth, size_t reservedCommands = 0);
 void hnet_host_finalize(HNetHost& host);
-int32_t hnet_host_service(HNetHost& host, HNetEvent& event);
+// lets hnet_host_wakeup cut a blocking service call short; false where the platform has no eventfd
+bool hnet_host_enable_wakeup(HNetHost& host);
+// callable from any thread: the current or next service call makes one more pass and returns
+void hnet_host_wakeup(HNetHost& host);
+int32_t hnet_host_service(HNetHost& host, HNetEvent& event, uint32_t timeout = 0);
+// one send/recv pass, then every dispatchable event up to capacity; returns the number of events or -1
+int32_t hnet_host_service_batch(HNetHost& host, HNetEvent* pEvents, size_t capacity, uint32_t timeout = 0);
+// dispatches one already received event without any I/O
+int32_t hnet_host_check_events(HNetHost& host, HNetEvent& event);
 HNetPeer* hnet_host_connect(HNetHost& host, const HNetAddr& addr, size_t channelCount, uint32_t data);
 void hnet_host_flush(HNetHost& host);
+// sends a datagram outside of any connection, e.g. a reply from the intercept callback
+int32_t hnet_host_send_raw(HNetHost& host, const HNetAddr& addr, const void* pData, size_t dataLength);
 bool hnet_host_get_addr(const char* pHostName, uint16_t port, HNetAddr& addr);
+void hnet_host_compress(HNetHost& host, const HNetCompressor* pCompressor);
+bool hnet_host_compress_with_lz(HNetHost& host);
+// compressed bytes per uncompressed byte sent; datagrams that did not shrink count at 1.0
+float hnet_host_get_compression_ratio(const HNetHost& host);
+// microseconds spent compressing per KB of uncompressed datagram data
+float hnet_host_get_compression_cost(const HNetHost& host);
+void hnet_host_bandwidth_throttle(HNetHost& host);
+void hnet_host_bandwidth_limit(HNetHost& host, uint32_t incomingBandwidth, uint32_t outgoingBandwidth);
+bool hnet_host_set_recv_batch_size(HNetHost& host, size_t batchSize);
+float hnet_host_get_recv_batch_average(const HNetHost& host);
+bool hnet_host_set_send_batch_size(HNetHost& host, size_t batchSize);
+float hnet_host_get_send_batch_average(const HNetHost& host);
+void hnet_host_schedule_peer(HNetHost& host, HNetPeer& peer, uint32_t deadline);
+void hnet_host_unschedule_peer(HNetHost& host, HNetPeer& peer);
+HNetPeer* hnet_host_acquire_peer(HNetHost& host);
+void hnet_host_release_peer(HNetHost& host, HNetPeer& peer);
+void hnet_host_set_peer_addr(HNetHost& host, HNetPeer& peer, const HNetAddr& addr);
+// peers whose host and port share a bucket with addr, chained through HNetPeer::bucketNext
+HNetPeer* hnet_host_find_peers(const HNetHost& host, const HNetAddr& addr);
+// number of indexed peers at addr's host on any port
+size_t hnet_host_count_peers(const HNetHost& host, const HNetAddr& addr);
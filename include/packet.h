@@ -1,8 +1,10 @@
 #pragma once
 
+#include <atomic>
 #include "types.h"
 
 struct HNetPacket;
+struct HNetPacketPools;
 
 using HNetPacketFreeCallback = void(*)(HNetPacket*);
 
@@ -14,13 +16,24 @@ using HNetPacketFreeCallback = void(*)(HNetPacket*);
 
 struct HNetPacket
 {
-    size_t refCount;
+    // atomic so packets (and the recv buffers their views point into) can be released on any thread
+    std::atomic<size_t> refCount;
     uint32_t flags;
+    uint8_t sizeClass;
+    // the creating thread's pools, which the block returns to wherever it is destroyed
+    HNetPacketPools* pools;
     uint8_t* data;
     size_t dataLength;
     HNetPacketFreeCallback freeCallback;
     void* userData;
+    HNetPacket* parent;
 };
 
 HNetPacket* hnet_packet_create(uint8_t* pData, size_t dataLength, uint32_t flags);
-void hnet_packet_destroy(HNetPacket* pPacket);
\ No newline at end of file
+HNetPacket* hnet_packet_create_view(HNetPacket& parent, uint8_t* pData, size_t dataLength, uint32_t flags);
+void hnet_packet_destroy(HNetPacket* pPacket);
+// hands the calling thread's packet pools to the next thread that creates packets; every thread other than
+// the main one calls it on exit. Its packets may still be destroyed anywhere afterwards
+void hnet_packet_detach_pools();
+// frees every thread's pools, once no thread uses packets anymore
+void hnet_packet_finalize_pools();
\ No newline at end of file
@@ -27,6 +27,7 @@ struct HNetPacket;
 #define HNET_PEER_RELIABLE_WINDOWS             16
 #define HNET_PEER_RELIABLE_WINDOW_SIZE         0x1000
 #define HNET_PEER_FREE_RELIABLE_WINDOWS        8
+#define HNET_PEER_TIMER_NONE                   SIZE_MAX
 
 enum class HNetPeerState : uint8_t
 {
@@ -44,6 +45,10 @@ enum class HNetPeerState : uint8_t
 
 struct HNetChannel
 {
+    HNetListNode ackList;
+    uint16_t ackBaseSeqNumber;
+    uint16_t ackSentTime;
+    uint32_t ackBitmap;
     uint16_t outgoingReliableSeqNumber;
     uint16_t outgoingUnreliableSeqNumber;
     uint16_t usedReliableWindows;
@@ -90,6 +95,8 @@ struct HNetPeer final
     uint32_t packetThrottleAcceleration;
     uint32_t packetThrottleDeceleration;
     uint32_t packetThrottleInterval;
+    uint32_t unreliablePacketsSent;
+    uint32_t unreliablePacketsThrottled;
     uint32_t pingInterval;
     uint32_t timeoutLimit;
     uint32_t timeoutMin;
@@ -104,19 +111,30 @@ struct HNetPeer final
     uint32_t mtu;
     uint32_t windowSize;
     uint32_t reliableDataInTransit;
+    bool reliableWindowStalled;
     uint16_t outgoingReliableSeqNumber;
     HNetList acks;
+    HNetList ackChannels;
+    bool selectiveAcks;
     HNetList sentReliableCommands;
     HNetList sentUnreliableCommands;
     HNetList outgoingReliableCommands;
     HNetList outgoingUnreliableCommands;
     HNetList dispatchedCommands;
     bool needsDispatch;
+    HNetListNode sendList;
+    bool needsSend;
     uint16_t incomingUnseqGroup;
     uint16_t outgoingUnseqGroup;
     uint32_t unseqWindow[HNET_PEER_UNSEQUENCED_WINDOW_SIZE / 32];
     uint32_t eventData;
     size_t totalWaitingData;
+    size_t unreliableFragmentData;
+    size_t timerIndex;
+    uint32_t timerDeadline;
+    HNetPeer* bucketNext;
+    bool isIndexed;
+    bool isFree;
 };
 
 struct HNetAck final
@@ -156,14 +174,22 @@ struct HNetIncomingCommand final
 void hnet_peer_on_connect(HNetPeer& peer);
 void hnet_peer_on_disconnect(HNetPeer& peer);
 void hnet_peer_disconnect(HNetPeer& peer, uint32_t data);
+void hnet_peer_queue_send(HNetPeer& peer);
+HNetPeer* hnet_peer_from_send_list(HNetListNode* pNode);
 void hnet_peer_reset(HNetPeer& peer);
 void hnet_peer_reset_queues(HNetPeer& peer);
 bool hnet_peer_queue_outgoing_command(HNetPeer& peer, const HNetProtocol& cmd, HNetPacket* pPacket, uint32_t offset, uint16_t length);
-bool hnet_peer_queue_outgoing_command(HNetPeer& peer, const HNetProtocol& cmd, HNetPacket* pPacket, uint32_t offset, uint16_t length);
-bool hnet_peer_queue_incoming_command(HNetPeer& peer, const HNetProtocol& cmd, uint8_t* pData, size_t dataLength, uint32_t flags, uint32_t fragmentCount);
+HNetIncomingCommand* hnet_peer_queue_incoming_command(HNetPeer& peer, const HNetProtocol& cmd, uint8_t* pData, size_t dataLength, uint32_t flags, uint32_t fragmentCount);
+void hnet_peer_dispatch_incoming_reliable_commands(HNetPeer& peer, HNetChannel& channel);
+void hnet_peer_dispatch_incoming_unreliable_commands(HNetPeer& peer, HNetChannel& channel, HNetIncomingCommand* pQueuedCmd);
+void hnet_peer_remove_unreliable_fragments(HNetPeer& peer, HNetChannel& channel);
 bool hnet_peer_queue_ack(HNetPeer& peer, const HNetProtocol& cmd, uint16_t sentTime);
 void hnet_peer_throttle(HNetPeer& peer, uint32_t rtt);
 bool hnet_peer_send(HNetPeer& peer, uint8_t channelId, HNetPacket& packet);
+// callable from any thread: the host takes the packet over and sends it on its next service or flush,
+// unless the session named by connectId (HNetEvent::connectId) has ended by then;
+// threads that created packets call hnet_packet_detach_pools before they exit
+bool hnet_peer_send_async(HNetPeer& peer, uint32_t connectId, uint8_t channelId, HNetPacket& packet);
 HNetPacket* hnet_peer_recv(HNetPeer& peer, uint8_t& channelId);
 void hnet_peer_ping(HNetPeer& peer);
 void hnet_peer_update_packet_loss(HNetPeer& peer, uint32_t currentTime);
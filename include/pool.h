@@ -0,0 +1,26 @@
+#pragma once
+
+#include "types.h"
+
+#define HNET_POOL_CACHE_LINE_SIZE 64
+#define HNET_POOL_DEFAULT_CHUNK_CAPACITY 64
+
+struct HNetPoolChunk;
+
+// fixed-size object pool; grows in cache-line aligned chunks and only returns memory on finalize
+struct HNetPool
+{
+    size_t objectSize;
+    size_t chunkCapacity;
+    HNetPoolChunk* chunks;
+    void* freeList;
+    size_t capacity;
+    size_t used;
+    size_t highWater;
+};
+
+void hnet_pool_initialize(HNetPool& pool, size_t objectSize, size_t chunkCapacity = HNET_POOL_DEFAULT_CHUNK_CAPACITY);
+void hnet_pool_finalize(HNetPool& pool);
+bool hnet_pool_reserve(HNetPool& pool, size_t count);
+void* hnet_pool_acquire(HNetPool& pool);
+void hnet_pool_release(HNetPool& pool, void* ptr);
\ No newline at end of file
@@ -15,6 +15,7 @@ struct HNetPeer;
 #define HNET_PROTOCOL_MAX_CHANNEL_COUNT   255
 #define HNET_PROTOCOL_MAX_PEER_ID         0xFFF
 #define HNET_PROTOCOL_MAX_FRAGMENT_COUNT  1024 * 1024
+#define HNET_PROTOCOL_SACK_WINDOW_SIZE    32
 
 #define HNET_PROTOCOL_COMMAND_FLAG_ACKNOWLEDGE (1 << 7)
 #define HNET_PROTOCOL_COMMAND_FLAG_UNSEQUENCED (1 << 6)
@@ -23,6 +24,10 @@ struct HNetPeer;
 #define HNET_PROTOCOL_HEADER_FLAG_SENT_TIME  (1 << 15)
 #define HNET_PROTOCOL_HEADER_FLAG_MASK       (HNET_PROTOCOL_HEADER_FLAG_COMPRESSED | HNET_PROTOCOL_HEADER_FLAG_SENT_TIME)
 
+// capability bits carried above the window size in connect/verify connect
+#define HNET_PROTOCOL_WINDOW_FLAG_SACK (1u << 31)
+#define HNET_PROTOCOL_WINDOW_SIZE_MASK (~HNET_PROTOCOL_WINDOW_FLAG_SACK)
+
 #define HNET_PROTOCOL_HEADER_SESSION_MASK  (3 << 12)
 #define HNET_PROTOCOL_HEADER_SESSION_SHIFT 12
 
@@ -43,6 +48,7 @@ enum HNetProtocolCommand : uint8_t
     HNET_PROTOCOL_COMMAND_BANDWIDTH_LIMIT,
     HNET_PROTOCOL_COMMAND_THROTTLE_CONFIGURE,
     HNET_PROTOCOL_COMMAND_SEND_UNRELIABLE_FRAGMENT,
+    HNET_PROTOCOL_COMMAND_SELECTIVE_ACKNOWLEDGE,
     HNET_PROTOCOL_COMMAND_COUNT,
     HNET_PROTOCOL_COMMAND_MASK = 0x0F,
 };
@@ -67,6 +73,14 @@ struct HNetProtocolAck
     uint16_t recvSentTime;
 } HNET_PACKED;
 
+// acknowledges header.reliableSeqNumber + i for every bit i set in ackBitmap
+struct HNetProtocolSelectiveAck
+{
+    HNetProtocolCommandHeader header;
+    uint16_t recvSentTime;
+    uint32_t ackBitmap;
+} HNET_PACKED;
+
 struct HNetProtocolConnect
 {
     HNetProtocolCommandHeader header;
@@ -163,6 +177,7 @@ union HNetProtocol
 {
     HNetProtocolCommandHeader header;
     HNetProtocolAck ack;
+    HNetProtocolSelectiveAck selectiveAck;
     HNetProtocolConnect connect;
     HNetProtocolVerifyConnect verifyConenct;
     HNetProtocolDisconnect disconnect;
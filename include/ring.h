@@ -0,0 +1,178 @@
+#pragma once
+
+#include <atomic>
+#include <new>
+#include "allocator.h"
+#include "types.h"
+
+#define HNET_CACHE_LINE_SIZE 64
+
+// single-producer single-consumer ring; each side owns a cache line and only re-reads the other
+// side's index when its cached copy says the ring looks full or empty
+template <typename T>
+struct HNetRing
+{
+    alignas(HNET_CACHE_LINE_SIZE) std::atomic<size_t> head;
+    size_t cachedTail;
+    alignas(HNET_CACHE_LINE_SIZE) std::atomic<size_t> tail;
+    size_t cachedHead;
+    alignas(HNET_CACHE_LINE_SIZE) T* items;
+    size_t mask;
+};
+
+template <typename T>
+bool hnet_ring_initialize(HNetRing<T>& ring, size_t capacity)
+{
+    size_t size = 1;
+    while (size < capacity) {
+        size *= 2;
+    }
+    ring.items = static_cast<T*>(hnet_malloc(size * sizeof(T)));
+    if (ring.items == nullptr) {
+        return false;
+    }
+    ring.mask = size - 1;
+    ring.head.store(0, std::memory_order_relaxed);
+    ring.tail.store(0, std::memory_order_relaxed);
+    ring.cachedHead = 0;
+    ring.cachedTail = 0;
+    return true;
+}
+
+template <typename T>
+void hnet_ring_finalize(HNetRing<T>& ring)
+{
+    hnet_free(ring.items);
+    ring.items = nullptr;
+}
+
+// producer side
+template <typename T>
+bool hnet_ring_push(HNetRing<T>& ring, const T& item)
+{
+    size_t tail = ring.tail.load(std::memory_order_relaxed);
+    if (tail - ring.cachedHead > ring.mask) {
+        ring.cachedHead = ring.head.load(std::memory_order_acquire);
+        if (tail - ring.cachedHead > ring.mask) {
+            return false;
+        }
+    }
+    ring.items[tail & ring.mask] = item;
+    ring.tail.store(tail + 1, std::memory_order_release);
+    return true;
+}
+
+template <typename T>
+bool hnet_ring_full(HNetRing<T>& ring)
+{
+    size_t tail = ring.tail.load(std::memory_order_relaxed);
+    if (tail - ring.cachedHead > ring.mask) {
+        ring.cachedHead = ring.head.load(std::memory_order_acquire);
+    }
+    return tail - ring.cachedHead > ring.mask;
+}
+
+// consumer side
+template <typename T>
+bool hnet_ring_pop(HNetRing<T>& ring, T& item)
+{
+    size_t head = ring.head.load(std::memory_order_relaxed);
+    if (head == ring.cachedTail) {
+        ring.cachedTail = ring.tail.load(std::memory_order_acquire);
+        if (head == ring.cachedTail) {
+            return false;
+        }
+    }
+    item = ring.items[head & ring.mask];
+    ring.head.store(head + 1, std::memory_order_release);
+    return true;
+}
+
+template <typename T>
+struct HNetMpscRingSlot
+{
+    std::atomic<size_t> sequence;
+    T item;
+};
+
+// bounded multi-producer single-consumer ring; producers claim slots with a CAS on tail and publish
+// them through the slot sequence, so the consumer never touches the producers' cache line
+template <typename T>
+struct HNetMpscRing
+{
+    alignas(HNET_CACHE_LINE_SIZE) std::atomic<size_t> tail;
+    alignas(HNET_CACHE_LINE_SIZE) size_t head;
+    HNetMpscRingSlot<T>* slots;
+    size_t mask;
+};
+
+template <typename T>
+bool hnet_mpsc_ring_initialize(HNetMpscRing<T>& ring, size_t capacity)
+{
+    size_t size = 1;
+    while (size < capacity) {
+        size *= 2;
+    }
+    ring.slots = static_cast<HNetMpscRingSlot<T>*>(hnet_malloc(size * sizeof(HNetMpscRingSlot<T>)));
+    if (ring.slots == nullptr) {
+        return false;
+    }
+    for (size_t i = 0; i < size; i++) {
+        new (&ring.slots[i].sequence) std::atomic<size_t>(i);
+    }
+    ring.mask = size - 1;
+    ring.tail.store(0, std::memory_order_relaxed);
+    ring.head = 0;
+    return true;
+}
+
+template <typename T>
+void hnet_mpsc_ring_finalize(HNetMpscRing<T>& ring)
+{
+    hnet_free(ring.slots);
+    ring.slots = nullptr;
+}
+
+// any thread
+template <typename T>
+bool hnet_mpsc_ring_push(HNetMpscRing<T>& ring, const T& item)
+{
+    size_t pos = ring.tail.load(std::memory_order_relaxed);
+    HNetMpscRingSlot<T>* pSlot;
+    for (;;) {
+        pSlot = &ring.slots[pos & ring.mask];
+        intptr_t diff = static_cast<intptr_t>(pSlot->sequence.load(std::memory_order_acquire)) - static_cast<intptr_t>(pos);
+        if (diff == 0) {
+            if (ring.tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            return false;
+        } else {
+            pos = ring.tail.load(std::memory_order_relaxed);
+        }
+    }
+    pSlot->item = item;
+    pSlot->sequence.store(pos + 1, std::memory_order_release);
+    return true;
+}
+
+// consumer side
+template <typename T>
+bool hnet_mpsc_ring_pop(HNetMpscRing<T>& ring, T& item)
+{
+    HNetMpscRingSlot<T>& slot = ring.slots[ring.head & ring.mask];
+    if (slot.sequence.load(std::memory_order_acquire) != ring.head + 1) {
+        return false;
+    }
+    item = slot.item;
+    slot.sequence.store(ring.head + ring.mask + 1, std::memory_order_release);
+    ring.head++;
+    return true;
+}
+
+template <typename T>
+bool hnet_mpsc_ring_empty(const HNetMpscRing<T>& ring)
+{
+    return ring.slots[ring.head & ring.mask].sequence.load(std::memory_order_acquire) != ring.head + 1;
+}
@@ -10,7 +10,7 @@ class HNetServer final
 public:
     static HNetServer* create(const char* pHostName, uint16_t port, size_t peerCount, size_t channelLimit = 0, uint32_t incomingBandwidth = 0, uint32_t outgoingBandwidth = 0);
     static void destroy(HNetServer*& pServer);
-    void update();
+    void update(uint32_t timeout = 0);
     void sendPacket();
 
 private:
@@ -18,6 +18,7 @@ enum class HNetSocketOption : uint8_t
     RCVBUF,
     SNDBUF,
     REUSEADDR,
+    REUSEPORT,
     RCVTIMEO,
     SNDTIMEO,
     ERROR,
@@ -28,12 +29,22 @@ enum class HNetSocketOption : uint8_t
 #define HNET_SOCKET_WAIT_SEND (1 << 0)
 #define HNET_SOCKET_WAIT_RECV (1 << 1)
 #define HNET_SOCKET_WAIT_INTR (1 << 2)
+#define HNET_SOCKET_WAIT_WAKEUP (1 << 3)
+
+struct HNetSocketMessage
+{
+    HNetAddr addr;
+    HNetBuffer* buffers;
+    size_t bufferCount;
+    size_t sentLength;
+};
 
 #define HNET_HOST_TO_NET_16(value) (htons(value))
 #define HNET_HOST_TO_NET_32(value) (htonl(value))
 #define HNET_NET_TO_HOST_16(value) (ntohs(value))
 #define HNET_NET_TO_HOST_32(value) (ntohl(value))
 #define HNET_SOCKET_NULL -1
+#define HNET_SOCKET_MAX_BATCH_SIZE 64
 
 bool hnet_address_set_host(HNetAddr& addr, const char* pHostName);
 bool hnet_address_set_host_ip(HNetAddr& addr, const char* pHostName);
@@ -43,6 +54,15 @@ bool hnet_socket_bind(HNetSocket socket, HNetAddr& addr);
 void hnet_socket_destroy(HNetSocket socket);
 bool hnet_socket_set_option(HNetSocket socket, HNetSocketOption option, int32_t val);
 bool hnet_socket_get_addr(HNetSocket socket, HNetAddr& addr);
-bool hnet_socket_wait(HNetSocket socket, uint32_t& cond, uint32_t timeout);
+// also returns once wakeup is signaled, reporting HNET_SOCKET_WAIT_WAKEUP and clearing the signal
+bool hnet_socket_wait(HNetSocket socket, uint32_t& cond, uint32_t timeout, HNetSocket wakeup = HNET_SOCKET_NULL);
+// an eventfd for hnet_socket_wait that any thread may signal; HNET_SOCKET_NULL where eventfd is missing
+HNetSocket hnet_socket_create_wakeup();
+void hnet_socket_signal_wakeup(HNetSocket wakeup);
+// steers every datagram to socket (id & shardMask) of the socket's SO_REUSEPORT group, where id is the
+// first 16 payload bits in network order masked by idMask; unassignedId and runts fall back to the kernel hash
+bool hnet_socket_set_reuseport_steering(HNetSocket socket, uint16_t idMask, uint16_t unassignedId, uint16_t shardMask);
 int32_t hnet_socket_send(HNetSocket socket, HNetAddr& addr, HNetBuffer* pBuffers, size_t bufferCount);
+int32_t hnet_socket_send_batch(HNetSocket socket, HNetSocketMessage* pMessages, size_t count);
 int32_t hnet_socket_recv(HNetSocket socket, HNetAddr& addr, HNetBuffer* pBuffers, size_t bufferCount);
+int32_t hnet_socket_recv_batch(HNetSocket socket, HNetAddr* pAddrs, HNetBuffer* pBuffers, size_t* pRecvLengths, size_t count);
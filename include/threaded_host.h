@@ -0,0 +1,61 @@
+#pragma once
+
+#include <atomic>
+#include <thread>
+#include "event.h"
+#include "host.h"
+#include "ring.h"
+
+#define HNET_THREADED_HOST_EVENT_RING_SIZE   4096
+#define HNET_THREADED_HOST_COMMAND_RING_SIZE 4096
+// how long a worker blocks in service; sends, disconnects and finalize wake it early unless the
+// platform lacks eventfd, when it falls back to polling its commands every HNET_THREADED_HOST_POLL_MSEC
+#define HNET_THREADED_HOST_WAIT_MSEC         1000
+#define HNET_THREADED_HOST_POLL_MSEC         1
+
+enum class HNetThreadedCommandType : uint8_t
+{
+    Send,
+    Disconnect,
+};
+
+// names the peer by id and session rather than by pointer, so a command that arrives after the slot was
+// reset or reused for another connection is dropped
+struct HNetThreadedCommand
+{
+    HNetThreadedCommandType type;
+    uint8_t channelId;
+    uint16_t peerId;
+    uint32_t connectId;
+    uint32_t data;
+    HNetPacket* packet;
+};
+
+// services one shard; the application thread is the only producer of commands and only consumer of events
+struct alignas(HNET_CACHE_LINE_SIZE) HNetShardWorker
+{
+    HNetRing<HNetEvent> events;
+    HNetRing<HNetThreadedCommand> commands;
+    HNetHost* host;
+    std::thread thread;
+    alignas(HNET_CACHE_LINE_SIZE) std::atomic<bool> stop;
+};
+
+// sharded hosts, each serviced by its own worker thread, behind one event stream for the application thread
+struct HNetThreadedHost
+{
+    HNetHost* hosts;
+    HNetShardWorker* workers;
+    size_t shardCount;
+    size_t nextShard;
+};
+
+bool hnet_threaded_host_initialize(HNetThreadedHost& host, HNetAddr& addr, size_t shardCount, size_t peerCount, size_t channelLimit, uint32_t incomingBandwidth, uint32_t outgoingBandwidth);
+void hnet_threaded_host_finalize(HNetThreadedHost& host);
+// pops the next event of any shard; never blocks
+int32_t hnet_threaded_host_service(HNetThreadedHost& host, HNetEvent& event);
+// hands the packet to the peer's worker, which owns it from then on; false if the shard's queue is full.
+// connectId is the HNetEvent::connectId of the peer's connect event; the worker destroys the packet
+// instead of sending it once that session is over
+bool hnet_threaded_host_send(HNetThreadedHost& host, HNetPeer& peer, uint32_t connectId, uint8_t channelId, HNetPacket& packet);
+bool hnet_threaded_host_disconnect(HNetThreadedHost& host, HNetPeer& peer, uint32_t connectId, uint32_t data);
@@ -4,15 +4,27 @@
 #include <stddef.h>
 #include <string.h>
 
+// IPv6 host in network byte order; IPv4 hosts are held v4-mapped (::ffff:a.b.c.d) so a single
+// dual-stack socket serves both and every address compares the same way
 struct HNetAddr
 {
-    uint32_t host;
+    union
+    {
+        uint8_t host[16];
+        uint64_t hostWords[2];
+    };
+    uint32_t scopeId;
     uint16_t port;
 };
 
 inline bool operator!=(const HNetAddr& a, const HNetAddr& b)
 {
-    return (a.host != b.host) || (a.port != b.port);
+    return ((a.hostWords[0] ^ b.hostWords[0]) | (a.hostWords[1] ^ b.hostWords[1]) | (a.scopeId ^ b.scopeId) | (a.port ^ b.port)) != 0;
+}
+
+inline bool hnet_address_equal_host(const HNetAddr& a, const HNetAddr& b)
+{
+    return ((a.hostWords[0] ^ b.hostWords[0]) | (a.hostWords[1] ^ b.hostWords[1])) == 0;
 }
 
 struct HNetBuffer
@@ -21,5 +33,32 @@ struct HNetBuffer
     size_t dataLength;
 };
 
+// IPv4 hosts in network byte order, for hnet_address_set_ipv4
 #define HNET_HOST_ANY       0
-#define HNET_HOST_BROADCAST 0xFFFFFFFFU
\ No newline at end of file
+#define HNET_HOST_BROADCAST 0xFFFFFFFFU
+
+inline constexpr uint8_t HNET_ADDRESS_V4_MAPPED_PREFIX[12] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xFF, 0xFF};
+
+inline void hnet_address_set_ipv4(HNetAddr& addr, uint32_t host)
+{
+    memcpy(addr.host, HNET_ADDRESS_V4_MAPPED_PREFIX, sizeof(HNET_ADDRESS_V4_MAPPED_PREFIX));
+    memcpy(addr.host + sizeof(HNET_ADDRESS_V4_MAPPED_PREFIX), &host, sizeof(host));
+    addr.scopeId = 0;
+}
+
+inline bool hnet_address_is_ipv4(const HNetAddr& addr)
+{
+    return memcmp(addr.host, HNET_ADDRESS_V4_MAPPED_PREFIX, sizeof(HNET_ADDRESS_V4_MAPPED_PREFIX)) == 0;
+}
+
+inline uint32_t hnet_address_get_ipv4(const HNetAddr& addr)
+{
+    uint32_t host;
+    memcpy(&host, addr.host + sizeof(HNET_ADDRESS_V4_MAPPED_PREFIX), sizeof(host));
+    return host;
+}
+
+inline bool hnet_address_is_broadcast(const HNetAddr& addr)
+{
+    return hnet_address_is_ipv4(addr) && hnet_address_get_ipv4(addr) == HNET_HOST_BROADCAST;
+}
\ No newline at end of file
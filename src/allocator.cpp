@@ -2,6 +2,13 @@
 
 static HNetAllocator allocator = {malloc, free, abort};
 
+void hnet_allocator_set(const HNetAllocator& callbacks)
+{
+    allocator.malloc = callbacks.malloc != nullptr ? callbacks.malloc : malloc;
+    allocator.free = callbacks.free != nullptr ? callbacks.free : free;
+    allocator.no_memory = callbacks.no_memory != nullptr ? callbacks.no_memory : abort;
+}
+
 void* hnet_malloc(size_t size)
 {
     void* ptr = allocator.malloc(size);
@@ -0,0 +1,221 @@
+#include "checksum.h"
+#include "socket.h"
+
+#if defined(__x86_64__)
+#include <nmmintrin.h>
+#include <wmmintrin.h>
+#define HNET_CRC32C_X86 1
+#endif
+
+#define HNET_CRC32C_POLY         0x82F63B78u
+#define HNET_CRC32C_LONG_STRIPE  256
+#define HNET_CRC32C_SHORT_STRIPE 32
+
+using HNetCrc32cUpdate = uint32_t(*)(uint32_t crc, const uint8_t* pData, size_t length);
+
+struct HNetCrc32cTables
+{
+    uint32_t slices[8][256];
+    // x^(8n-33) mod P for the stripe lengths, used to shift a lane's crc past the lanes after it
+    uint32_t longShift1;
+    uint32_t longShift2;
+    uint32_t shortShift1;
+    uint32_t shortShift2;
+};
+
+static uint32_t hnet_crc32c_xpow(size_t power)
+{
+    // reflected bit 31 is x^0; multiplying by x is a right shift that wraps x^32 back into P
+    uint32_t value = 0x80000000u;
+    for (size_t i = 0; i < power; i++) {
+        value = (value & 1) ? (value >> 1) ^ HNET_CRC32C_POLY : value >> 1;
+    }
+    return value;
+}
+
+static const HNetCrc32cTables& hnet_crc32c_tables()
+{
+    static const HNetCrc32cTables tables = [] {
+        HNetCrc32cTables t{};
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t crc = i;
+            for (int j = 0; j < 8; j++) {
+                crc = (crc & 1) ? (crc >> 1) ^ HNET_CRC32C_POLY : crc >> 1;
+            }
+            t.slices[0][i] = crc;
+        }
+        for (uint32_t i = 0; i < 256; i++) {
+            for (int j = 1; j < 8; j++) {
+                t.slices[j][i] = (t.slices[j - 1][i] >> 8) ^ t.slices[0][t.slices[j - 1][i] & 0xFF];
+            }
+        }
+        t.longShift1 = hnet_crc32c_xpow(8 * HNET_CRC32C_LONG_STRIPE - 33);
+        t.longShift2 = hnet_crc32c_xpow(8 * 2 * HNET_CRC32C_LONG_STRIPE - 33);
+        t.shortShift1 = hnet_crc32c_xpow(8 * HNET_CRC32C_SHORT_STRIPE - 33);
+        t.shortShift2 = hnet_crc32c_xpow(8 * 2 * HNET_CRC32C_SHORT_STRIPE - 33);
+        return t;
+    }();
+    return tables;
+}
+
+static uint32_t hnet_crc32c_update_slicing8(uint32_t crc, const uint8_t* pData, size_t length)
+{
+    const HNetCrc32cTables& t = hnet_crc32c_tables();
+    for (; length > 0 && (reinterpret_cast<uintptr_t>(pData) & 7) != 0; length--) {
+        crc = (crc >> 8) ^ t.slices[0][(crc ^ *pData++) & 0xFF];
+    }
+    for (; length >= 8; length -= 8, pData += 8) {
+        uint32_t low;
+        uint32_t high;
+        memcpy(&low, pData, sizeof(low));
+        memcpy(&high, pData + 4, sizeof(high));
+        low ^= crc;
+        crc = t.slices[7][low & 0xFF] ^
+              t.slices[6][(low >> 8) & 0xFF] ^
+              t.slices[5][(low >> 16) & 0xFF] ^
+              t.slices[4][low >> 24] ^
+              t.slices[3][high & 0xFF] ^
+              t.slices[2][(high >> 8) & 0xFF] ^
+              t.slices[1][(high >> 16) & 0xFF] ^
+              t.slices[0][high >> 24];
+    }
+    for (; length > 0; length--) {
+        crc = (crc >> 8) ^ t.slices[0][(crc ^ *pData++) & 0xFF];
+    }
+    return crc;
+}
+
+#if HNET_CRC32C_X86
+__attribute__((target("sse4.2")))
+static uint32_t hnet_crc32c_update_sse42(uint32_t crc, const uint8_t* pData, size_t length)
+{
+    for (; length > 0 && (reinterpret_cast<uintptr_t>(pData) & 7) != 0; length--) {
+        crc = _mm_crc32_u8(crc, *pData++);
+    }
+    uint64_t crc64 = crc;
+    for (; length >= 8; length -= 8, pData += 8) {
+        uint64_t value;
+        memcpy(&value, pData, sizeof(value));
+        crc64 = _mm_crc32_u64(crc64, value);
+    }
+    crc = static_cast<uint32_t>(crc64);
+    for (; length > 0; length--) {
+        crc = _mm_crc32_u8(crc, *pData++);
+    }
+    return crc;
+}
+
+__attribute__((target("sse4.2,pclmul")))
+static uint32_t hnet_crc32c_shift(uint32_t crc, uint32_t shift)
+{
+    // crc * x^(8n-33) * x^33: the carry-less product adds one x, the crc32 reduction adds x^32
+    __m128i product = _mm_clmulepi64_si128(_mm_cvtsi32_si128(static_cast<int>(crc)), _mm_cvtsi32_si128(static_cast<int>(shift)), 0);
+    return static_cast<uint32_t>(_mm_crc32_u64(0, static_cast<uint64_t>(_mm_cvtsi128_si64(product))));
+}
+
+// three independent crc32 chains hide the instruction latency; pclmul merges them per stripe
+__attribute__((target("sse4.2,pclmul")))
+static uint32_t hnet_crc32c_update_stripes(uint32_t crc, const uint8_t*& pData, size_t& length, size_t stripe, uint32_t shift1, uint32_t shift2)
+{
+    while (length >= 3 * stripe) {
+        uint64_t crcA = crc;
+        uint64_t crcB = 0;
+        uint64_t crcC = 0;
+        for (size_t i = 0; i < stripe; i += 8) {
+            uint64_t a;
+            uint64_t b;
+            uint64_t c;
+            memcpy(&a, pData + i, sizeof(a));
+            memcpy(&b, pData + stripe + i, sizeof(b));
+            memcpy(&c, pData + 2 * stripe + i, sizeof(c));
+            crcA = _mm_crc32_u64(crcA, a);
+            crcB = _mm_crc32_u64(crcB, b);
+            crcC = _mm_crc32_u64(crcC, c);
+        }
+        crc = hnet_crc32c_shift(static_cast<uint32_t>(crcA), shift2) ^
+              hnet_crc32c_shift(static_cast<uint32_t>(crcB), shift1) ^
+              static_cast<uint32_t>(crcC);
+        pData += 3 * stripe;
+        length -= 3 * stripe;
+    }
+    return crc;
+}
+
+__attribute__((target("sse4.2,pclmul")))
+static uint32_t hnet_crc32c_update_pclmul(uint32_t crc, const uint8_t* pData, size_t length)
+{
+    const HNetCrc32cTables& t = hnet_crc32c_tables();
+    crc = hnet_crc32c_update_stripes(crc, pData, length, HNET_CRC32C_LONG_STRIPE, t.longShift1, t.longShift2);
+    crc = hnet_crc32c_update_stripes(crc, pData, length, HNET_CRC32C_SHORT_STRIPE, t.shortShift1, t.shortShift2);
+    return hnet_crc32c_update_sse42(crc, pData, length);
+}
+#endif
+
+static HNetCrc32cUpdate hnet_crc32c_update(HNetCrc32cImpl impl)
+{
+#if HNET_CRC32C_X86
+    switch (impl) {
+    case HNetCrc32cImpl::Sse42:
+        return hnet_crc32c_update_sse42;
+    case HNetCrc32cImpl::Pclmul:
+        return hnet_crc32c_update_pclmul;
+    default:
+        break;
+    }
+#endif
+    return hnet_crc32c_update_slicing8;
+}
+
+static uint32_t hnet_crc32c_run(HNetCrc32cUpdate update, const HNetBuffer* pBuffers, size_t bufferCount)
+{
+    // the crc register simply carries over from one buffer to the next
+    uint32_t crc = 0xFFFFFFFFu;
+    for (size_t i = 0; i < bufferCount; i++) {
+        crc = update(crc, static_cast<const uint8_t*>(pBuffers[i].data), pBuffers[i].dataLength);
+    }
+    return HNET_HOST_TO_NET_32(~crc);
+}
+
+bool hnet_crc32c_supported(HNetCrc32cImpl impl)
+{
+    switch (impl) {
+    case HNetCrc32cImpl::Slicing8:
+        return true;
+#if HNET_CRC32C_X86
+    case HNetCrc32cImpl::Sse42:
+        return __builtin_cpu_supports("sse4.2");
+    case HNetCrc32cImpl::Pclmul:
+        return __builtin_cpu_supports("sse4.2") && __builtin_cpu_supports("pclmul");
+#endif
+    default:
+        return false;
+    }
+}
+
+HNetCrc32cImpl hnet_crc32c_best_impl()
+{
+    static const HNetCrc32cImpl impl = [] {
+        if (hnet_crc32c_supported(HNetCrc32cImpl::Pclmul)) {
+            return HNetCrc32cImpl::Pclmul;
+        }
+        if (hnet_crc32c_supported(HNetCrc32cImpl::Sse42)) {
+            return HNetCrc32cImpl::Sse42;
+        }
+        return HNetCrc32cImpl::Slicing8;
+    }();
+    return impl;
+}
+
+uint32_t hnet_crc32c(const HNetBuffer* pBuffers, size_t bufferCount)
+{
+    static const HNetCrc32cUpdate update = hnet_crc32c_update(hnet_crc32c_best_impl());
+    return hnet_crc32c_run(update, pBuffers, bufferCount);
+}
+
+uint32_t hnet_crc32c_with(HNetCrc32cImpl impl, const HNetBuffer* pBuffers, size_t bufferCount)
+{
+    if (!hnet_crc32c_supported(impl)) {
+        impl = HNetCrc32cImpl::Slicing8;
+    }
+    return hnet_crc32c_run(hnet_crc32c_update(impl), pBuffers, bufferCount);
+}
@@ -40,10 +40,10 @@ bool HNetClient::connect(const char* pHostName, uint16_t port)
     return true;
 }
 
-void HNetClient::update()
+void HNetClient::update(uint32_t timeout)
 {
     HNetEvent event;
-    int32_t ret = hnet_host_service(m_Host, event);
+    int32_t ret = hnet_host_service(m_Host, event, timeout);
     if (ret > 0) {
         switch (event.type) {
         case HNetEventType::Connect:
@@ -0,0 +1,210 @@
+#include <algorithm>
+#include "allocator.h"
+#include "compressor.h"
+
+// block format: sequences of [token][literal length+][literals][offset:16][match length+],
+// token = literal length << 4 | (match length - HNET_LZ_MIN_MATCH); the last sequence has no match
+#define HNET_LZ_MIN_MATCH  4
+#define HNET_LZ_MAX_OFFSET 0xFFFF
+#define HNET_LZ_RUN_MASK   15
+
+struct HNetLZContext
+{
+    uint8_t window[HNET_LZ_WINDOW_SIZE];
+    uint16_t table[1 << HNET_LZ_HASH_BITS];
+};
+
+static uint32_t hnet_lz_read32(const uint8_t* p)
+{
+    uint32_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static uint32_t hnet_lz_hash(uint32_t value)
+{
+    return (value * 2654435761u) >> (32 - HNET_LZ_HASH_BITS);
+}
+
+static bool hnet_lz_write_length(uint8_t*& pOut, const uint8_t* pOutEnd, size_t length)
+{
+    for (; length >= 255; length -= 255) {
+        if (pOut >= pOutEnd) {
+            return false;
+        }
+        *pOut++ = 255;
+    }
+    if (pOut >= pOutEnd) {
+        return false;
+    }
+    *pOut++ = static_cast<uint8_t>(length);
+    return true;
+}
+
+static bool hnet_lz_read_length(const uint8_t*& pIn, const uint8_t* pInEnd, size_t& length)
+{
+    uint8_t value;
+    do {
+        if (pIn >= pInEnd) {
+            return false;
+        }
+        value = *pIn++;
+        length += value;
+    } while (value == 255);
+    return true;
+}
+
+static bool hnet_lz_write_sequence(uint8_t*& pOut, const uint8_t* pOutEnd, const uint8_t* pLiterals, size_t literalLength, size_t offset, size_t matchLength)
+{
+    if (pOut >= pOutEnd) {
+        return false;
+    }
+
+    uint8_t* pToken = pOut++;
+    size_t matchCode = matchLength > 0 ? matchLength - HNET_LZ_MIN_MATCH : 0;
+    *pToken = static_cast<uint8_t>((std::min<size_t>(literalLength, HNET_LZ_RUN_MASK) << 4) | std::min<size_t>(matchCode, HNET_LZ_RUN_MASK));
+
+    if (literalLength >= HNET_LZ_RUN_MASK && !hnet_lz_write_length(pOut, pOutEnd, literalLength - HNET_LZ_RUN_MASK)) {
+        return false;
+    }
+    if (static_cast<size_t>(pOutEnd - pOut) < literalLength) {
+        return false;
+    }
+    memcpy(pOut, pLiterals, literalLength);
+    pOut += literalLength;
+
+    if (matchLength == 0) {
+        return true;
+    }
+
+    if (pOutEnd - pOut < 2) {
+        return false;
+    }
+    *pOut++ = static_cast<uint8_t>(offset);
+    *pOut++ = static_cast<uint8_t>(offset >> 8);
+
+    return matchCode < HNET_LZ_RUN_MASK || hnet_lz_write_length(pOut, pOutEnd, matchCode - HNET_LZ_RUN_MASK);
+}
+
+void* hnet_lz_create()
+{
+    HNetLZContext* pContext = static_cast<HNetLZContext*>(hnet_malloc(sizeof(HNetLZContext)));
+    if (pContext != nullptr) {
+        memset(pContext->table, 0, sizeof(pContext->table));
+    }
+    return pContext;
+}
+
+void hnet_lz_destroy(void* context)
+{
+    hnet_free(context);
+}
+
+size_t hnet_lz_compress(void* context, const HNetBuffer* inBuffers, size_t inBufferCount, size_t inLimit, uint8_t* outData, size_t outLimit)
+{
+    HNetLZContext& ctx = *static_cast<HNetLZContext*>(context);
+    if (inLimit > sizeof(ctx.window)) {
+        return 0;
+    }
+
+    // matches may span buffer boundaries, so the iovecs are laid out back to back in the window
+    size_t inLength = 0;
+    for (size_t i = 0; i < inBufferCount && inLength < inLimit; i++) {
+        size_t length = std::min(inBuffers[i].dataLength, inLimit - inLength);
+        memcpy(ctx.window + inLength, inBuffers[i].data, length);
+        inLength += length;
+    }
+
+    // stale table entries from earlier datagrams are harmless: every candidate is verified
+    const uint8_t* pWindow = ctx.window;
+    uint8_t* pOut = outData;
+    const uint8_t* pOutEnd = outData + outLimit;
+    size_t anchor = 0;
+    size_t pos = 0;
+    while (pos + HNET_LZ_MIN_MATCH <= inLength) {
+        uint32_t value = hnet_lz_read32(pWindow + pos);
+        uint16_t& entry = ctx.table[hnet_lz_hash(value)];
+        size_t candidate = entry;
+        entry = static_cast<uint16_t>(pos);
+
+        if (candidate >= pos || pos - candidate > HNET_LZ_MAX_OFFSET || hnet_lz_read32(pWindow + candidate) != value) {
+            ++pos;
+            continue;
+        }
+
+        size_t matchLength = HNET_LZ_MIN_MATCH;
+        while (pos + matchLength < inLength && pWindow[candidate + matchLength] == pWindow[pos + matchLength]) {
+            ++matchLength;
+        }
+
+        if (!hnet_lz_write_sequence(pOut, pOutEnd, pWindow + anchor, pos - anchor, pos - candidate, matchLength)) {
+            return 0;
+        }
+        pos += matchLength;
+        anchor = pos;
+    }
+
+    if (!hnet_lz_write_sequence(pOut, pOutEnd, pWindow + anchor, inLength - anchor, 0, 0)) {
+        return 0;
+    }
+
+    return pOut - outData;
+}
+
+size_t hnet_lz_decompress(void* context, const uint8_t* inData, size_t inLimit, uint8_t* outData, size_t outLimit)
+{
+    const uint8_t* pIn = inData;
+    const uint8_t* pInEnd = inData + inLimit;
+    uint8_t* pOut = outData;
+    uint8_t* pOutEnd = outData + outLimit;
+
+    while (pIn < pInEnd) {
+        uint8_t token = *pIn++;
+
+        size_t literalLength = token >> 4;
+        if (literalLength == HNET_LZ_RUN_MASK && !hnet_lz_read_length(pIn, pInEnd, literalLength)) {
+            return 0;
+        }
+        if (static_cast<size_t>(pInEnd - pIn) < literalLength || static_cast<size_t>(pOutEnd - pOut) < literalLength) {
+            return 0;
+        }
+        memcpy(pOut, pIn, literalLength);
+        pIn += literalLength;
+        pOut += literalLength;
+
+        if (pIn == pInEnd) {
+            break;
+        }
+
+        if (pInEnd - pIn < 2) {
+            return 0;
+        }
+        size_t offset = pIn[0] | (pIn[1] << 8);
+        pIn += 2;
+        if (offset == 0 || offset > static_cast<size_t>(pOut - outData)) {
+            return 0;
+        }
+
+        size_t matchLength = token & HNET_LZ_RUN_MASK;
+        if (matchLength == HNET_LZ_RUN_MASK && !hnet_lz_read_length(pIn, pInEnd, matchLength)) {
+            return 0;
+        }
+        matchLength += HNET_LZ_MIN_MATCH;
+        if (static_cast<size_t>(pOutEnd - pOut) < matchLength) {
+            return 0;
+        }
+
+        // overlapping copies repeat the last offset bytes, so those go byte by byte
+        const uint8_t* pMatch = pOut - offset;
+        if (offset >= matchLength) {
+            memcpy(pOut, pMatch, matchLength);
+        } else {
+            for (size_t i = 0; i < matchLength; i++) {
+                pOut[i] = pMatch[i];
+            }
+        }
+        pOut += matchLength;
+    }
+
+    return pOut - outData;
+}
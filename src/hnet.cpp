@@ -1,4 +1,5 @@
 #include "hnet.h"
+#include "packet.h"
 
 bool hnet_initialize()
 {
@@ -6,4 +7,6 @@ bool hnet_initialize()
 }
 
 void hnet_finalize()
-{}
+{
+    hnet_packet_finalize_pools();
+}
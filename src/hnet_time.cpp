@@ -1,14 +1,29 @@
 #include <chrono>
+#include <time.h>
 #include "hnet_time.h"
 
+#if defined(CLOCK_MONOTONIC_COARSE)
+#define HNET_TIME_CLOCK_COARSE CLOCK_MONOTONIC_COARSE
+#else
+#define HNET_TIME_CLOCK_COARSE CLOCK_MONOTONIC
+#endif
+
 uint64_t hnet_time_now_msec()
 {
-    using namespace std::chrono;
-    return duration_cast<milliseconds>(system_clock::now().time_since_epoch()).count();
+    timespec ts;
+    clock_gettime(HNET_TIME_CLOCK_COARSE, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000 + ts.tv_nsec / 1000000;
+}
+
+uint64_t hnet_time_now_usec()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
 }
 
 uint64_t hnet_time_now_sec()
 {
     using namespace std::chrono;
     return duration_cast<seconds>(system_clock::now().time_since_epoch()).count();
-}
+}
\ No newline at end of file
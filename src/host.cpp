@@ -4,6 +4,7 @@
 #include "hnet.h"
 #include "hnet_time.h"
 #include "host.h"
+#include "packet.h"
 #include "peer.h"
 #include "protocol.h"
 #include "socket.h"
@@ -13,6 +14,34 @@ static uint32_t hnet_host_random_seed()
     return static_cast<uint32_t>(hnet_time_now_sec());
 }
 
+static HNetRecvBuffer* hnet_host_create_recv_buffers(size_t count)
+{
+    HNetRecvBuffer* pRecvBuffers = static_cast<HNetRecvBuffer*>(hnet_malloc(count * sizeof(HNetRecvBuffer)));
+    if (pRecvBuffers != nullptr) {
+        memset(pRecvBuffers, 0, count * sizeof(HNetRecvBuffer));
+    }
+    return pRecvBuffers;
+}
+
+static void hnet_host_destroy_recv_buffers(HNetRecvBuffer* pRecvBuffers, size_t count)
+{
+    for (size_t i = 0; i < count; i++) {
+        HNetPacket* pPacket = pRecvBuffers[i].packet;
+        if (pPacket != nullptr && --pPacket->refCount == 0) {
+            hnet_packet_destroy(pPacket);
+        }
+    }
+    hnet_free(pRecvBuffers);
+}
+
+static uint32_t hnet_host_now(HNetHost& host)
+{
+    if (host.clock != nullptr) {
+        return host.clock(&host);
+    }
+    return static_cast<uint32_t>(hnet_time_now_msec());
+}
+
 static HNetSocket hnet_host_create_socket()
 {
     HNetSocket socket = hnet_socket_create(HNetSocketType::DataGram);
@@ -36,34 +65,121 @@ static bool hnet_host_bind_socket(HNetHost& host, HNetSocket socket, HNetAddr& a
     return true;
 }
 
-static HNetPeer* hnet_host_create_peers(HNetHost& host, size_t peerCount)
+static size_t hnet_host_peer_bucket(const HNetHost& host, const HNetAddr& addr)
 {
-    if (peerCount > HNET_PROTOCOL_MAX_PEER_ID) {
-        return nullptr;
+    uint64_t hash = (addr.hostWords[0] ^ addr.hostWords[1] ^ addr.port) * 0x9E3779B97F4A7C15ull;
+    return static_cast<size_t>(hash ^ (hash >> 32)) & host.peerBucketMask;
+}
+
+static size_t hnet_host_count_home(const HNetHost& host, const HNetAddr& addr)
+{
+    uint64_t hash = (addr.hostWords[0] ^ addr.hostWords[1]) * 0x9E3779B97F4A7C15ull;
+    return static_cast<size_t>(hash ^ (hash >> 32)) & host.peerBucketMask;
+}
+
+// linear probe for addr's host; the table has twice as many slots as peers, so an empty slot always ends the run
+static size_t hnet_host_find_count(const HNetHost& host, const HNetAddr& addr)
+{
+    size_t index = hnet_host_count_home(host, addr);
+    while (host.hostCounts[index].count != 0 && !hnet_address_equal_host(host.hostCounts[index].addr, addr)) {
+        index = (index + 1) & host.peerBucketMask;
+    }
+    return index;
+}
+
+static void hnet_host_count_peer(HNetHost& host, const HNetAddr& addr)
+{
+    HNetHostCount& entry = host.hostCounts[hnet_host_find_count(host, addr)];
+    if (entry.count++ == 0) {
+        entry.addr = addr;
+    }
+}
+
+static void hnet_host_uncount_peer(HNetHost& host, const HNetAddr& addr)
+{
+    size_t hole = hnet_host_find_count(host, addr);
+    if (--host.hostCounts[hole].count != 0) {
+        return;
+    }
+    // shift later entries of the probe run back so none becomes unreachable behind the emptied slot
+    size_t mask = host.peerBucketMask;
+    for (size_t index = (hole + 1) & mask; host.hostCounts[index].count != 0; index = (index + 1) & mask) {
+        size_t home = hnet_host_count_home(host, host.hostCounts[index].addr);
+        if (((index - home) & mask) >= ((index - hole) & mask)) {
+            host.hostCounts[hole] = host.hostCounts[index];
+            host.hostCounts[index].count = 0;
+            hole = index;
+        }
+    }
+}
+
+static bool hnet_host_create_peers(HNetHost& host, size_t peerCount)
+{
+    if ((peerCount << host.shardBits) > HNET_PROTOCOL_MAX_PEER_ID) {
+        return false;
+    }
+
+    size_t bucketCount = HNET_HOST_MIN_PEER_BUCKETS;
+    while (bucketCount < peerCount * 2) {
+        bucketCount *= 2;
     }
 
     HNetPeer* pPeers = static_cast<HNetPeer*>(hnet_malloc(peerCount * sizeof(HNetPeer)));
-    if (pPeers == nullptr) {
-        return nullptr;
+    HNetPeer** pFreePeers = static_cast<HNetPeer**>(hnet_malloc(peerCount * sizeof(HNetPeer*)));
+    HNetPeer** pPeerTimers = static_cast<HNetPeer**>(hnet_malloc(peerCount * sizeof(HNetPeer*)));
+    HNetPeer** pPeerBuckets = static_cast<HNetPeer**>(hnet_malloc(bucketCount * sizeof(HNetPeer*)));
+    HNetHostCount* pHostCounts = static_cast<HNetHostCount*>(hnet_malloc(bucketCount * sizeof(HNetHostCount)));
+    if (pPeers == nullptr || pFreePeers == nullptr || pPeerTimers == nullptr || pPeerBuckets == nullptr || pHostCounts == nullptr) {
+        hnet_free(pPeers);
+        hnet_free(pFreePeers);
+        hnet_free(pPeerTimers);
+        hnet_free(pPeerBuckets);
+        hnet_free(pHostCounts);
+        return false;
     }
     memset(pPeers, 0, peerCount * sizeof(HNetPeer));
+    memset(pPeerBuckets, 0, bucketCount * sizeof(HNetPeer*));
+    memset(pHostCounts, 0, bucketCount * sizeof(HNetHostCount));
+
+    host.peers = pPeers;
+    host.peerCount = peerCount;
+    host.freePeers = pFreePeers;
+    host.freePeerCount = 0;
+    host.peerTimers = pPeerTimers;
+    host.peerTimerCount = 0;
+    host.peerBuckets = pPeerBuckets;
+    host.hostCounts = pHostCounts;
+    host.peerBucketMask = bucketCount - 1;
 
     for (size_t i = 0; i < peerCount; i++) {
         HNetPeer& peer = pPeers[i];
         peer.host = &host;
-        peer.incomingPeerId = i;
+        peer.incomingPeerId = static_cast<uint16_t>((i << host.shardBits) | host.shardIndex);
         peer.outgoingSessionId = peer.incomingSessionId = 0xFF;
         peer.data = nullptr;
         peer.acks.clear();
+        peer.ackChannels.clear();
         peer.sentReliableCommands.clear();
         peer.sentUnreliableCommands.clear();
         peer.outgoingReliableCommands.clear();
         peer.outgoingUnreliableCommands.clear();
         peer.dispatchedCommands.clear();
+        peer.timerIndex = HNET_PEER_TIMER_NONE;
         hnet_peer_reset(peer);
     }
 
-    return pPeers;
+    // hand out the lowest peer ids first
+    std::reverse(host.freePeers, host.freePeers + host.freePeerCount);
+    return true;
+}
+
+static void hnet_host_destroy_peers(HNetHost& host)
+{
+    hnet_free(host.peers);
+    hnet_free(host.freePeers);
+    hnet_free(host.peerTimers);
+    hnet_free(host.peerBuckets);
+    hnet_free(host.hostCounts);
 }
 
 static HNetChannel* hnet_host_create_channels(size_t& channelCount)
@@ -84,24 +200,14 @@ static HNetChannel* hnet_host_create_channels(size_t& channelCount)
         channel.incomingUnreliableCommands.clear();
         channel.usedReliableWindows = 0;
         memset(channel.reliableWindows, 0, sizeof(channel.reliableWindows));
+        channel.ackBaseSeqNumber = 0;
+        channel.ackSentTime = 0;
+        channel.ackBitmap = 0;
     }
 
     return pChannels;
 }
 
-static HNetPeer* hnet_host_find_available_peer(HNetHost& host)
-{
-    HNetPeer* pPeer = nullptr;
-    for (size_t i = 0; i < host.peerCount; i++) {
-        HNetPeer& peer = host.peers[i];
-        if (peer.state == HNetPeerState::Disconnected) {
-            pPeer = &peer;
-            break;
-        }
-    }
-    return pPeer;
-}
-
 uint32_t hnet_host_get_init_window_size(uint32_t outgoingBandwidth)
 {
     uint32_t windowSize = HNET_PROTOCOL_MAX_WINDOW_SIZE;
@@ -111,20 +217,59 @@ uint32_t hnet_host_get_init_window_size(uint32_t outgoingBandwidth)
     return std::clamp<uint32_t>(windowSize, HNET_PROTOCOL_MIN_WINDOW_SIZE, HNET_PROTOCOL_MAX_WINDOW_SIZE);
 }
 
-bool hnet_host_initialize(HNetHost& host, HNetAddr* pAddr, size_t peerCount, size_t channelLimit, uint32_t incomingBandwidth, uint32_t outgoingBandwidth)
+static bool hnet_host_initialize_shard(HNetHost& host, HNetAddr* pAddr, size_t shardIndex, size_t shardBits, size_t peerCount, size_t channelLimit, uint32_t incomingBandwidth, uint32_t outgoingBandwidth, size_t reservedCommands)
 {
     HNetSocket socket = hnet_host_create_socket();
     if (socket == HNET_SOCKET_NULL) {
         return false;
     }
 
+    if (shardBits > 0 && !hnet_socket_set_option(socket, HNetSocketOption::REUSEPORT, 1)) {
+        hnet_socket_destroy(socket);
+        return false;
+    }
+
     if(pAddr != nullptr && !hnet_host_bind_socket(host, socket, *pAddr)) {
         hnet_socket_destroy(socket);
         return false;
     }
 
-    HNetPeer* pPeers = hnet_host_create_peers(host, peerCount);
-    if (pPeers == nullptr) {
+    host.mtu = HNET_HOST_DEFAULT_MTU;
+    host.shardIndex = static_cast<uint16_t>(shardIndex);
+    host.shardBits = static_cast<uint8_t>(shardBits);
+    if (!hnet_host_create_peers(host, peerCount)) {
+        hnet_socket_destroy(socket);
+        return false;
+    }
+
+    HNetRecvBuffer* pRecvBuffers = hnet_host_create_recv_buffers(HNET_HOST_DEFAULT_RECV_BATCH_SIZE);
+    if (pRecvBuffers == nullptr) {
+        hnet_host_destroy_peers(host);
+        hnet_socket_destroy(socket);
+        return false;
+    }
+
+    HNetSendBuffer* pSendBuffers = static_cast<HNetSendBuffer*>(hnet_malloc(HNET_HOST_DEFAULT_SEND_BATCH_SIZE * sizeof(HNetSendBuffer)));
+    if (pSendBuffers == nullptr) {
+        hnet_free(pRecvBuffers);
+        hnet_host_destroy_peers(host);
+        hnet_socket_destroy(socket);
+        return false;
+    }
+
+    hnet_pool_initialize(host.outgoingCommandPool, sizeof(HNetOutgoingCommand));
+    hnet_pool_initialize(host.incomingCommandPool, sizeof(HNetIncomingCommand));
+    hnet_pool_initialize(host.ackPool, sizeof(HNetAck));
+    if (!hnet_pool_reserve(host.outgoingCommandPool, reservedCommands) ||
+        !hnet_pool_reserve(host.incomingCommandPool, reservedCommands) ||
+        !hnet_pool_reserve(host.ackPool, reservedCommands) ||
+        !hnet_mpsc_ring_initialize(host.asyncSends, HNET_HOST_ASYNC_SEND_QUEUE_SIZE)) {
+        hnet_pool_finalize(host.outgoingCommandPool);
+        hnet_pool_finalize(host.incomingCommandPool);
+        hnet_pool_finalize(host.ackPool);
+        hnet_free(pSendBuffers);
+        hnet_free(pRecvBuffers);
+        hnet_host_destroy_peers(host);
         hnet_socket_destroy(socket);
         return false;
     }
@@ -134,6 +279,7 @@ bool hnet_host_initialize(HNetHost& host, HNetAddr* pAddr, size_t peerCount, siz
     }
 
     host.socket = socket;
+    host.wakeup = HNET_SOCKET_NULL;
     host.randomSeed = static_cast<uint32_t>(reinterpret_cast<uintptr_t>(&host));
     host.randomSeed += hnet_host_random_seed();
     host.randomSeed = (host.randomSeed << 16) | (host.randomSeed >> 16);
@@ -142,16 +288,27 @@ bool hnet_host_initialize(HNetHost& host, HNetAddr* pAddr, size_t peerCount, siz
     host.outgoingBandwidth = outgoingBandwidth;
     host.bandwidthThrottleEpoch = 0;
     host.recalculateBandwidthLimits = false;
-    host.mtu = HNET_HOST_DEFAULT_MTU;
-    host.peers = pPeers;
-    host.peerCount = peerCount;
+    host.commands = pSendBuffers[0].commands;
     host.commandCount = 0;
+    host.buffers = pSendBuffers[0].buffers;
     host.bufferCount = 0;
+    host.sendBuffers = pSendBuffers;
+    host.sendBatchSize = HNET_HOST_DEFAULT_SEND_BATCH_SIZE;
+    host.sendBatchCount = 0;
+    host.totalSendBatches = 0;
+    host.totalSendBatchPackets = 0;
     host.checksum = nullptr;
-    host.recvAddr.host = HNET_HOST_ANY;
+    host.recvAddr = HNetAddr{};
     host.recvAddr.port = 0;
     host.recvData = nullptr;
     host.recvDataLength = 0;
+    host.recvPacket = nullptr;
+    host.recvBuffers = pRecvBuffers;
+    host.recvBatchSize = HNET_HOST_DEFAULT_RECV_BATCH_SIZE;
+    host.recvBatchCount = 0;
+    host.recvBatchIndex = 0;
+    host.totalRecvBatches = 0;
+    host.totalRecvBatchPackets = 0;
     host.totalSentData = 0;
     host.totalSentPackets = 0;
     host.totalRecvData = 0;
@@ -161,52 +318,248 @@ bool hnet_host_initialize(HNetHost& host, HNetAddr* pAddr, size_t peerCount, siz
     host.duplicatePeers = HNET_PROTOCOL_MAX_PEER_ID;
     host.maxPacketSize = HNET_HOST_DEFAULT_MAX_PACKET_SIZE;
     host.maxWaitingData = HNET_HOST_DEFAULT_MAX_WAITING_DATA;
+    host.maxUnreliableFragmentData = HNET_HOST_DEFAULT_MAX_FRAGMENT_DATA;
     host.compressor.context = nullptr;
     host.compressor.compress = nullptr;
     host.compressor.decompress = nullptr;
     host.compressor.destroy = nullptr;
+    host.totalCompressInput = 0;
+    host.totalCompressOutput = 0;
+    host.compressTime = 0;
+    host.decompressTime = 0;
     host.intercept = nullptr;
+    host.clock = nullptr;
+    host.selectiveAcks = true;
+    return true;
+}
+
+bool hnet_host_initialize(HNetHost& host, HNetAddr* pAddr, size_t peerCount, size_t channelLimit, uint32_t incomingBandwidth, uint32_t outgoingBandwidth, size_t reservedCommands)
+{
+    return hnet_host_initialize_shard(host, pAddr, 0, 0, peerCount, channelLimit, incomingBandwidth, outgoingBandwidth, reservedCommands);
+}
+
+bool hnet_host_initialize_shards(HNetHost* pHosts, size_t shardCount, HNetAddr& addr, size_t peerCount, size_t channelLimit, uint32_t incomingBandwidth, uint32_t outgoingBandwidth, size_t reservedCommands)
+{
+    size_t shardBits = 0;
+    while ((static_cast<size_t>(1) << shardBits) < shardCount) {
+        shardBits++;
+    }
+    if (shardCount < 2 || (static_cast<size_t>(1) << shardBits) != shardCount || shardCount > HNET_HOST_MAX_SHARDS) {
+        return false;
+    }
+
+    // the reuseport group indexes sockets in bind order, so shard i has to be the i-th to bind
+    HNetAddr shardAddr = addr;
+    for (size_t i = 0; i < shardCount; i++) {
+        if (!hnet_host_initialize_shard(pHosts[i], &shardAddr, i, shardBits, peerCount, channelLimit, incomingBandwidth, outgoingBandwidth, reservedCommands)) {
+            while (i > 0) {
+                hnet_host_finalize(pHosts[--i]);
+            }
+            return false;
+        }
+        shardAddr.port = pHosts[i].addr.port;
+    }
+
+    uint16_t peerIdMask = static_cast<uint16_t>(~(HNET_PROTOCOL_HEADER_FLAG_MASK | HNET_PROTOCOL_HEADER_SESSION_MASK));
+    if (!hnet_socket_set_reuseport_steering(pHosts[0].socket, peerIdMask, HNET_PROTOCOL_MAX_PEER_ID, static_cast<uint16_t>(shardCount - 1))) {
+        for (size_t i = 0; i < shardCount; i++) {
+            hnet_host_finalize(pHosts[i]);
+        }
+        return false;
+    }
+
+    addr.port = shardAddr.port;
     return true;
 }
 
 void hnet_host_finalize(HNetHost& host)
 {
     hnet_socket_destroy(host.socket);
+    hnet_socket_destroy(host.wakeup);
     for (size_t i = 0; i < host.peerCount; i++) {
         hnet_peer_reset(host.peers[i]);
     }
-    hnet_free(host.peers);
+    hnet_host_destroy_peers(host);
+    hnet_host_destroy_recv_buffers(host.recvBuffers, host.recvBatchSize);
+    hnet_free(host.sendBuffers);
+    hnet_pool_finalize(host.outgoingCommandPool);
+    hnet_pool_finalize(host.incomingCommandPool);
+    hnet_pool_finalize(host.ackPool);
+    hnet_host_compress(host, nullptr);
+
+    HNetAsyncSend send;
+    while (hnet_mpsc_ring_pop(host.asyncSends, send)) {
+        hnet_packet_destroy(send.packet);
+    }
+    hnet_mpsc_ring_finalize(host.asyncSends);
+}
+
+bool hnet_host_enable_wakeup(HNetHost& host)
+{
+    if (host.wakeup == HNET_SOCKET_NULL) {
+        host.wakeup = hnet_socket_create_wakeup();
+    }
+    return host.wakeup != HNET_SOCKET_NULL;
+}
+
+void hnet_host_wakeup(HNetHost& host)
+{
+    if (host.wakeup != HNET_SOCKET_NULL) {
+        hnet_socket_signal_wakeup(host.wakeup);
+    }
+}
+
+static uint32_t hnet_host_next_deadline(const HNetHost& host, uint32_t deadline)
+{
+    if (host.recvBatchIndex < host.recvBatchCount) {
+        return host.serviceTime;
+    }
+
+    if (host.incomingBandwidth != 0 || host.outgoingBandwidth != 0) {
+        uint32_t throttleTime = host.bandwidthThrottleEpoch + HNET_HOST_BANDWIDTH_THROTTLE_INTERVAL;
+        if (HNET_TIME_LT(throttleTime, deadline)) {
+            deadline = throttleTime;
+        }
+    }
+
+    if (host.peerTimerCount > 0 && HNET_TIME_LT(host.peerTimers[0]->timerDeadline, deadline)) {
+        deadline = host.peerTimers[0]->timerDeadline;
+    }
+
+    if (!host.sendQueue.empty() || !hnet_mpsc_ring_empty(host.asyncSends)) {
+        return host.serviceTime;
+    }
+
+    return deadline;
+}
+
+// a wakeup pulls timeoutTime in so the caller makes one more pass and returns. So does a custom clock:
+// its time only moves when the caller steps it, so blocking on it in real time could never reach the timeout
+static bool hnet_host_wait(HNetHost& host, uint32_t& timeoutTime)
+{
+    uint32_t deadline = hnet_host_next_deadline(host, timeoutTime);
+    uint32_t waitTime = HNET_TIME_LT(host.serviceTime, deadline) ? HNET_TIME_DIFF(deadline, host.serviceTime) : 0;
+    if (host.clock != nullptr) {
+        waitTime = 0;
+    }
+    uint32_t cond = HNET_SOCKET_WAIT_RECV | HNET_SOCKET_WAIT_INTR;
+    if (!hnet_socket_wait(host.socket, cond, waitTime, host.wakeup)) {
+        return false;
+    }
+
+    host.serviceTime = hnet_host_now(host);
+    if ((cond & HNET_SOCKET_WAIT_WAKEUP) || host.clock != nullptr) {
+        timeoutTime = host.serviceTime;
+    }
+    return true;
 }
 
-int32_t hnet_host_service(HNetHost& host, HNetEvent& event)
+int32_t hnet_host_service(HNetHost& host, HNetEvent& event, uint32_t timeout)
 {
-    host.serviceTime = static_cast<uint32_t>(hnet_time_now_msec());
     event.type = HNetEventType::None;
     event.peer = nullptr;
     event.packet = nullptr;
 
-    int32_t ret = hnet_protocol_send_outgoing_commands(host, &event, true);
-    if (ret != 0) {
-        return ret;
+    host.serviceTime = hnet_host_now(host);
+    uint32_t timeoutTime = host.serviceTime + timeout;
+
+    for (;;) {
+        if (HNET_TIME_DIFF(host.serviceTime, host.bandwidthThrottleEpoch) >= HNET_HOST_BANDWIDTH_THROTTLE_INTERVAL) {
+            hnet_host_bandwidth_throttle(host);
+        }
+
+        int32_t ret = hnet_protocol_send_outgoing_commands(host, &event, true);
+        if (ret != 0) {
+            return ret;
+        }
+
+        ret = hnet_protocol_recv_incoming_commands(host, event);
+        if (ret != 0) {
+            return ret;
+        }
+
+        ret = hnet_protocol_dispatch_incoming_commands(host, event);
+        if (ret != 0) {
+            return ret;
+        }
+
+        if (HNET_TIME_GE(host.serviceTime, timeoutTime)) {
+            return 0;
+        }
+
+        if (!hnet_host_wait(host, timeoutTime)) {
+            return -1;
+        }
     }
+}
+
+static void hnet_host_clear_event(HNetEvent& event)
+{
+    event.type = HNetEventType::None;
+    event.peer = nullptr;
+    event.packet = nullptr;
+}
 
-    ret = hnet_protocol_recv_incoming_commands(host, event);
-    if (ret != 0) {
-        return ret;
+int32_t hnet_host_service_batch(HNetHost& host, HNetEvent* pEvents, size_t capacity, uint32_t timeout)
+{
+    // events already waiting in the dispatch queue need no I/O at all
+    size_t eventCount = 0;
+    while (eventCount < capacity && hnet_host_check_events(host, pEvents[eventCount]) > 0) {
+        eventCount++;
+    }
+    if (eventCount == capacity) {
+        return static_cast<int32_t>(eventCount);
     }
 
-    ret = hnet_protocol_dispatch_incoming_commands(host, event);
-    if (ret != 0) {
-        return ret;
+    host.serviceTime = hnet_host_now(host);
+    uint32_t timeoutTime = host.serviceTime + timeout;
+
+    for (;;) {
+        if (HNET_TIME_DIFF(host.serviceTime, host.bandwidthThrottleEpoch) >= HNET_HOST_BANDWIDTH_THROTTLE_INTERVAL) {
+            hnet_host_bandwidth_throttle(host);
+        }
+
+        // each pass stops at its first event, so keep going until it has nothing left or the array is full
+        int32_t ret = 1;
+        while (ret > 0 && eventCount < capacity) {
+            hnet_host_clear_event(pEvents[eventCount]);
+            ret = hnet_protocol_send_outgoing_commands(host, &pEvents[eventCount], true);
+            eventCount += ret > 0 ? 1 : 0;
+        }
+        if (ret == 0) {
+            ret = 1;
+            while (ret > 0 && eventCount < capacity) {
+                hnet_host_clear_event(pEvents[eventCount]);
+                ret = hnet_protocol_recv_incoming_commands(host, pEvents[eventCount]);
+                eventCount += ret > 0 ? 1 : 0;
+            }
+        }
+        while (ret >= 0 && eventCount < capacity && hnet_host_check_events(host, pEvents[eventCount]) > 0) {
+            eventCount++;
+        }
+
+        if (ret < 0) {
+            return eventCount > 0 ? static_cast<int32_t>(eventCount) : -1;
+        }
+        if (eventCount > 0 || HNET_TIME_GE(host.serviceTime, timeoutTime)) {
+            return static_cast<int32_t>(eventCount);
+        }
+
+        if (!hnet_host_wait(host, timeoutTime)) {
+            return -1;
+        }
     }
+}
 
-    return 0;
+int32_t hnet_host_check_events(HNetHost& host, HNetEvent& event)
+{
+    hnet_host_clear_event(event);
+    return hnet_protocol_dispatch_incoming_commands(host, event);
 }
 
 HNetPeer* hnet_host_connect(HNetHost& host, const HNetAddr& addr, size_t channelCount, uint32_t data)
 {
-    HNetPeer* pCurrentPeer = hnet_host_find_available_peer(host);
-    if (pCurrentPeer == nullptr) {
+    if (host.freePeerCount == 0) {
         return nullptr;
     }
 
@@ -215,18 +568,20 @@ HNetPeer* hnet_host_connect(HNetHost& host, const HNetAddr& addr, size_t channel
         return nullptr;
     }
 
+    HNetPeer* pCurrentPeer = hnet_host_acquire_peer(host);
     pCurrentPeer->channels = pChannels;
     pCurrentPeer->channelCount = channelCount;
     pCurrentPeer->state = HNetPeerState::Connecting;
-    pCurrentPeer->addr = addr;
+    hnet_host_set_peer_addr(host, *pCurrentPeer, addr);
     pCurrentPeer->connectId = ++host.randomSeed;
     pCurrentPeer->windowSize = hnet_host_get_init_window_size(host.outgoingBandwidth);
+    pCurrentPeer->selectiveAcks = host.selectiveAcks;
 
     HNetProtocol cmd;
     hnet_protocol_init_connect_command(host, *pCurrentPeer, data, cmd);
 
     if (!hnet_peer_queue_outgoing_command(*pCurrentPeer, cmd, nullptr, 0, 0)) {
-        hnet_free(pChannels);
+        hnet_peer_reset(*pCurrentPeer);
         return nullptr;
     }
 
@@ -235,13 +590,27 @@ HNetPeer* hnet_host_connect(HNetHost& host, const HNetAddr& addr, size_t channel
 
 void hnet_host_flush(HNetHost& host)
 {
-    host.serviceTime = hnet_time_now_msec();
+    host.serviceTime = hnet_host_now(host);
     hnet_protocol_send_outgoing_commands(host, nullptr, false);
 }
 
+int32_t hnet_host_send_raw(HNetHost& host, const HNetAddr& addr, const void* pData, size_t dataLength)
+{
+    // bypasses the peer send batch, so a reply never waits on, or reorders, connected traffic
+    HNetAddr dest = addr;
+    HNetBuffer buffer{const_cast<void*>(pData), dataLength};
+    int32_t sentLength = hnet_socket_send(host.socket, dest, &buffer, 1);
+    if (sentLength > 0) {
+        host.totalSentData += sentLength;
+        host.totalSentPackets++;
+    }
+    return sentLength;
+}
+
 bool hnet_host_get_addr(const char* pHostName, uint16_t port, HNetAddr& addr)
 {
-    addr.host = HNET_HOST_ANY;
+    // no host name binds the unspecified IPv6 address, which also takes IPv4 on a dual-stack socket
+    addr = HNetAddr{};
     addr.port = port;
     if (pHostName != nullptr) {
         if (!hnet_address_set_host(addr, pHostName)) {
@@ -249,4 +618,395 @@ bool hnet_host_get_addr(const char* pHostName, uint16_t port, HNetAddr& addr)
         }
     }
     return true;
-}
\ No newline at end of file
+}
+
+void hnet_host_compress(HNetHost& host, const HNetCompressor* pCompressor)
+{
+    if (host.compressor.context != nullptr && host.compressor.destroy != nullptr) {
+        host.compressor.destroy(host.compressor.context);
+    }
+
+    if (pCompressor != nullptr) {
+        host.compressor = *pCompressor;
+    } else {
+        host.compressor.context = nullptr;
+    }
+}
+
+bool hnet_host_compress_with_lz(HNetHost& host)
+{
+    HNetCompressor compressor;
+    compressor.context = hnet_lz_create();
+    if (compressor.context == nullptr) {
+        return false;
+    }
+    compressor.compress = hnet_lz_compress;
+    compressor.decompress = hnet_lz_decompress;
+    compressor.destroy = hnet_lz_destroy;
+    hnet_host_compress(host, &compressor);
+    return true;
+}
+
+float hnet_host_get_compression_ratio(const HNetHost& host)
+{
+    if (host.totalCompressInput == 0) {
+        return 1.0f;
+    }
+    return static_cast<float>(host.totalCompressOutput) / host.totalCompressInput;
+}
+
+float hnet_host_get_compression_cost(const HNetHost& host)
+{
+    if (host.totalCompressInput == 0) {
+        return 0.0f;
+    }
+    return static_cast<float>(host.compressTime) * 1024.0f / host.totalCompressInput;
+}
+
+static bool hnet_host_is_peer_connected(const HNetPeer& peer)
+{
+    return peer.state == HNetPeerState::Connected || peer.state == HNetPeerState::DisconnectLater;
+}
+
+static uint32_t hnet_host_scale_bandwidth(uint32_t bandwidth, uint32_t elapsedTime)
+{
+    return static_cast<uint32_t>(std::min<uint64_t>(static_cast<uint64_t>(bandwidth) * elapsedTime / 1000, UINT32_MAX));
+}
+
+static uint32_t hnet_host_packet_throttle(uint32_t bandwidth, uint32_t dataTotal)
+{
+    if (dataTotal <= bandwidth) {
+        return HNET_PEER_PACKET_THROTTLE_SCALE;
+    }
+    return static_cast<uint32_t>(static_cast<uint64_t>(bandwidth) * HNET_PEER_PACKET_THROTTLE_SCALE / dataTotal);
+}
+
+static void hnet_host_send_bandwidth_limits(HNetHost& host, uint32_t currentTime)
+{
+    size_t peersRemaining = host.connectedPeers;
+    uint32_t bandwidth = host.incomingBandwidth;
+    uint32_t bandwidthLimit = 0;
+    bool needsAdjustment = bandwidth != 0;
+
+    // peers sending less than an even share keep what they asked for, the rest split what is left
+    while (peersRemaining > 0 && needsAdjustment) {
+        needsAdjustment = false;
+        bandwidthLimit = bandwidth / peersRemaining;
+
+        for (size_t i = 0; i < host.peerCount; i++) {
+            HNetPeer& peer = host.peers[i];
+            if (!hnet_host_is_peer_connected(peer) || peer.incomingBandwidthThrottoleEpoch == currentTime) {
+                continue;
+            }
+            if (peer.outgoingBandwidth == 0 || peer.outgoingBandwidth >= bandwidthLimit) {
+                continue;
+            }
+
+            peer.incomingBandwidthThrottoleEpoch = currentTime;
+            needsAdjustment = true;
+            --peersRemaining;
+            bandwidth -= peer.outgoingBandwidth;
+        }
+    }
+
+    for (size_t i = 0; i < host.peerCount; i++) {
+        HNetPeer& peer = host.peers[i];
+        if (!hnet_host_is_peer_connected(peer)) {
+            continue;
+        }
+
+        HNetProtocol cmd;
+        cmd.header.command = HNET_PROTOCOL_COMMAND_BANDWIDTH_LIMIT | HNET_PROTOCOL_COMMAND_FLAG_ACKNOWLEDGE;
+        cmd.header.channelId = 0xFF;
+        cmd.bandwidthLimit.outgoingBandwidth = HNET_HOST_TO_NET_32(host.outgoingBandwidth);
+        if (peer.incomingBandwidthThrottoleEpoch == currentTime) {
+            cmd.bandwidthLimit.incomingBandwidth = HNET_HOST_TO_NET_32(peer.outgoingBandwidth);
+        } else {
+            cmd.bandwidthLimit.incomingBandwidth = HNET_HOST_TO_NET_32(bandwidthLimit);
+        }
+        hnet_peer_queue_outgoing_command(peer, cmd, nullptr, 0, 0);
+    }
+}
+
+void hnet_host_bandwidth_throttle(HNetHost& host)
+{
+    uint32_t currentTime = host.serviceTime;
+    uint32_t elapsedTime = HNET_TIME_DIFF(currentTime, host.bandwidthThrottleEpoch);
+    if (elapsedTime < HNET_HOST_BANDWIDTH_THROTTLE_INTERVAL) {
+        return;
+    }
+    // unlimited with no downlink-limited peers leaves every limit at the scale once a final pass has reset it
+    if (host.outgoingBandwidth == 0 && host.incomingBandwidth == 0 && host.bandwidthLimitedPeers == 0 && !host.recalculateBandwidthLimits) {
+        return;
+    }
+
+    host.bandwidthThrottleEpoch = currentTime;
+    if (host.connectedPeers == 0) {
+        return;
+    }
+
+    uint32_t dataTotal = UINT32_MAX;
+    uint32_t bandwidth = UINT32_MAX;
+    if (host.outgoingBandwidth != 0) {
+        dataTotal = 0;
+        bandwidth = hnet_host_scale_bandwidth(host.outgoingBandwidth, elapsedTime);
+        for (size_t i = 0; i < host.peerCount; i++) {
+            const HNetPeer& peer = host.peers[i];
+            if (hnet_host_is_peer_connected(peer)) {
+                dataTotal += peer.outgoingDataTotal;
+            }
+        }
+    }
+
+    // peers that advertised a smaller downlink than their share get limited to it first
+    size_t peersRemaining = host.connectedPeers;
+    bool needsAdjustment = host.bandwidthLimitedPeers > 0;
+    while (peersRemaining > 0 && needsAdjustment) {
+        needsAdjustment = false;
+        uint32_t throttle = hnet_host_packet_throttle(bandwidth, dataTotal);
+
+        for (size_t i = 0; i < host.peerCount; i++) {
+            HNetPeer& peer = host.peers[i];
+            if (!hnet_host_is_peer_connected(peer) || peer.incomingBandwidth == 0 || peer.outgoingBandwidthThrottoleEpoch == currentTime) {
+                continue;
+            }
+
+            uint32_t peerBandwidth = hnet_host_scale_bandwidth(peer.incomingBandwidth, elapsedTime);
+            if (static_cast<uint64_t>(throttle) * peer.outgoingDataTotal / HNET_PEER_PACKET_THROTTLE_SCALE <= peerBandwidth) {
+                continue;
+            }
+
+            peer.packetThrottleLimit = static_cast<uint32_t>(static_cast<uint64_t>(peerBandwidth) * HNET_PEER_PACKET_THROTTLE_SCALE / peer.outgoingDataTotal);
+            if (peer.packetThrottleLimit == 0) {
+                peer.packetThrottleLimit = 1;
+            }
+            if (peer.packetThrottle > peer.packetThrottleLimit) {
+                peer.packetThrottle = peer.packetThrottleLimit;
+            }
+
+            peer.outgoingBandwidthThrottoleEpoch = currentTime;
+            peer.incomingDataTotal = 0;
+            peer.outgoingDataTotal = 0;
+
+            needsAdjustment = true;
+            --peersRemaining;
+            bandwidth -= std::min(bandwidth, peerBandwidth);
+            dataTotal -= std::min(dataTotal, peerBandwidth);
+        }
+    }
+
+    if (peersRemaining > 0) {
+        uint32_t throttle = hnet_host_packet_throttle(bandwidth, dataTotal);
+        for (size_t i = 0; i < host.peerCount; i++) {
+            HNetPeer& peer = host.peers[i];
+            if (!hnet_host_is_peer_connected(peer) || peer.outgoingBandwidthThrottoleEpoch == currentTime) {
+                continue;
+            }
+
+            peer.packetThrottleLimit = throttle;
+            if (peer.packetThrottle > peer.packetThrottleLimit) {
+                peer.packetThrottle = peer.packetThrottleLimit;
+            }
+
+            peer.incomingDataTotal = 0;
+            peer.outgoingDataTotal = 0;
+        }
+    }
+
+    if (host.recalculateBandwidthLimits) {
+        host.recalculateBandwidthLimits = false;
+        hnet_host_send_bandwidth_limits(host, currentTime);
+    }
+}
+
+void hnet_host_bandwidth_limit(HNetHost& host, uint32_t incomingBandwidth, uint32_t outgoingBandwidth)
+{
+    host.incomingBandwidth = incomingBandwidth;
+    host.outgoingBandwidth = outgoingBandwidth;
+    host.recalculateBandwidthLimits = true;
+}
+
+bool hnet_host_set_recv_batch_size(HNetHost& host, size_t batchSize)
+{
+    if (batchSize == 0 || batchSize > HNET_SOCKET_MAX_BATCH_SIZE || host.recvBatchIndex < host.recvBatchCount) {
+        return false;
+    }
+
+    HNetRecvBuffer* pRecvBuffers = hnet_host_create_recv_buffers(batchSize);
+    if (pRecvBuffers == nullptr) {
+        return false;
+    }
+
+    hnet_host_destroy_recv_buffers(host.recvBuffers, host.recvBatchSize);
+    host.recvBuffers = pRecvBuffers;
+    host.recvBatchSize = batchSize;
+    host.recvBatchCount = 0;
+    host.recvBatchIndex = 0;
+    return true;
+}
+
+float hnet_host_get_recv_batch_average(const HNetHost& host)
+{
+    if (host.totalRecvBatches == 0) {
+        return 0.0f;
+    }
+    return static_cast<float>(host.totalRecvBatchPackets) / host.totalRecvBatches;
+}
+
+bool hnet_host_set_send_batch_size(HNetHost& host, size_t batchSize)
+{
+    if (batchSize == 0 || batchSize > HNET_SOCKET_MAX_BATCH_SIZE || host.sendBatchCount > 0) {
+        return false;
+    }
+
+    HNetSendBuffer* pSendBuffers = static_cast<HNetSendBuffer*>(hnet_malloc(batchSize * sizeof(HNetSendBuffer)));
+    if (pSendBuffers == nullptr) {
+        return false;
+    }
+
+    hnet_free(host.sendBuffers);
+    host.sendBuffers = pSendBuffers;
+    host.sendBatchSize = batchSize;
+    host.commands = pSendBuffers[0].commands;
+    host.buffers = pSendBuffers[0].buffers;
+    return true;
+}
+
+float hnet_host_get_send_batch_average(const HNetHost& host)
+{
+    if (host.totalSendBatches == 0) {
+        return 0.0f;
+    }
+    return static_cast<float>(host.totalSendBatchPackets) / host.totalSendBatches;
+}
+
+static void hnet_host_swap_peer_timers(HNetHost& host, size_t a, size_t b)
+{
+    HNetPeer* pPeer = host.peerTimers[a];
+    host.peerTimers[a] = host.peerTimers[b];
+    host.peerTimers[b] = pPeer;
+    host.peerTimers[a]->timerIndex = a;
+    host.peerTimers[b]->timerIndex = b;
+}
+
+static void hnet_host_sift_peer_timer(HNetHost& host, size_t index)
+{
+    while (index > 0) {
+        size_t parent = (index - 1) / 2;
+        if (!HNET_TIME_LT(host.peerTimers[index]->timerDeadline, host.peerTimers[parent]->timerDeadline)) {
+            break;
+        }
+        hnet_host_swap_peer_timers(host, index, parent);
+        index = parent;
+    }
+
+    for (;;) {
+        size_t earliest = index;
+        size_t left = index * 2 + 1;
+        size_t right = left + 1;
+        if (left < host.peerTimerCount && HNET_TIME_LT(host.peerTimers[left]->timerDeadline, host.peerTimers[earliest]->timerDeadline)) {
+            earliest = left;
+        }
+        if (right < host.peerTimerCount && HNET_TIME_LT(host.peerTimers[right]->timerDeadline, host.peerTimers[earliest]->timerDeadline)) {
+            earliest = right;
+        }
+        if (earliest == index) {
+            break;
+        }
+        hnet_host_swap_peer_timers(host, index, earliest);
+        index = earliest;
+    }
+}
+
+void hnet_host_schedule_peer(HNetHost& host, HNetPeer& peer, uint32_t deadline)
+{
+    if (peer.timerIndex == HNET_PEER_TIMER_NONE) {
+        peer.timerIndex = host.peerTimerCount++;
+        host.peerTimers[peer.timerIndex] = &peer;
+    } else if (peer.timerDeadline == deadline) {
+        return;
+    }
+    peer.timerDeadline = deadline;
+    hnet_host_sift_peer_timer(host, peer.timerIndex);
+}
+
+void hnet_host_unschedule_peer(HNetHost& host, HNetPeer& peer)
+{
+    if (peer.timerIndex == HNET_PEER_TIMER_NONE) {
+        return;
+    }
+
+    size_t index = peer.timerIndex;
+    size_t last = --host.peerTimerCount;
+    if (index != last) {
+        hnet_host_swap_peer_timers(host, index, last);
+    }
+    peer.timerIndex = HNET_PEER_TIMER_NONE;
+    if (index != last) {
+        hnet_host_sift_peer_timer(host, index);
+    }
+}
+
+HNetPeer* hnet_host_acquire_peer(HNetHost& host)
+{
+    if (host.freePeerCount == 0) {
+        return nullptr;
+    }
+    HNetPeer* pPeer = host.freePeers[--host.freePeerCount];
+    pPeer->isFree = false;
+    return pPeer;
+}
+
+void hnet_host_release_peer(HNetHost& host, HNetPeer& peer)
+{
+    if (peer.isIndexed) {
+        HNetPeer** ppPeer = &host.peerBuckets[hnet_host_peer_bucket(host, peer.addr)];
+        while (*ppPeer != &peer) {
+            ppPeer = &(*ppPeer)->bucketNext;
+        }
+        *ppPeer = peer.bucketNext;
+        peer.bucketNext = nullptr;
+        peer.isIndexed = false;
+        hnet_host_uncount_peer(host, peer.addr);
+    }
+    if (!peer.isFree) {
+        host.freePeers[host.freePeerCount++] = &peer;
+        peer.isFree = true;
+    }
+}
+
+void hnet_host_set_peer_addr(HNetHost& host, HNetPeer& peer, const HNetAddr& addr)
+{
+    if (peer.isIndexed) {
+        if (!(peer.addr != addr)) {
+            return;
+        }
+        HNetPeer** ppPeer = &host.peerBuckets[hnet_host_peer_bucket(host, peer.addr)];
+        while (*ppPeer != &peer) {
+            ppPeer = &(*ppPeer)->bucketNext;
+        }
+        *ppPeer = peer.bucketNext;
+        if (!hnet_address_equal_host(peer.addr, addr)) {
+            hnet_host_uncount_peer(host, peer.addr);
+            hnet_host_count_peer(host, addr);
+        }
+    } else {
+        hnet_host_count_peer(host, addr);
+    }
+
+    peer.addr = addr;
+    HNetPeer*& pBucket = host.peerBuckets[hnet_host_peer_bucket(host, addr)];
+    peer.bucketNext = pBucket;
+    pBucket = &peer;
+    peer.isIndexed = true;
+}
+
+HNetPeer* hnet_host_find_peers(const HNetHost& host, const HNetAddr& addr)
+{
+    return host.peerBuckets[hnet_host_peer_bucket(host, addr)];
+}
+
+size_t hnet_host_count_peers(const HNetHost& host, const HNetAddr& addr)
+{
+    return host.hostCounts[hnet_host_find_count(host, addr)].count;
+}
@@ -1,9 +1,107 @@
+#include <mutex>
+#include <vector>
 #include "allocator.h"
 #include "packet.h"
+#include "pool.h"
+
+// payload and header share one block taken from power-of-two pools (64B up to 64KB)
+#define HNET_PACKET_SIZE_CLASS_MIN_SHIFT 6
+#define HNET_PACKET_SIZE_CLASS_COUNT     11
+#define HNET_PACKET_SIZE_CLASS_NONE      0xFF
+#define HNET_PACKET_POOL_CHUNK_SIZE      (64 * 1024)
+
+// one set per thread so sharded hosts never contend. A packet destroyed on another thread goes back to its
+// owner through a lock-free list the owner drains when its pool runs dry, so blocks never migrate between
+// threads. Sets outlive their threads: an exited thread's set keeps taking remote frees and is handed to
+// the next thread that creates packets
+struct HNetPacketPools
+{
+    HNetPool pools[HNET_PACKET_SIZE_CLASS_COUNT];
+    HNetPacketPools* next;
+    alignas(HNET_POOL_CACHE_LINE_SIZE) std::atomic<void*> remoteFrees[HNET_PACKET_SIZE_CLASS_COUNT];
+};
+
+static thread_local HNetPacketPools* t_packetPools = nullptr;
+static std::vector<HNetPacketPools*> s_packetPools;
+static HNetPacketPools* s_detachedPools = nullptr;
+static std::mutex s_packetPoolsMutex;
+
+static HNetPacketPools* hnet_packet_attach_pools()
+{
+    std::lock_guard<std::mutex> lock(s_packetPoolsMutex);
+    if (s_detachedPools != nullptr) {
+        HNetPacketPools* pPools = s_detachedPools;
+        s_detachedPools = pPools->next;
+        return pPools;
+    }
+
+    HNetPacketPools* pPools = new HNetPacketPools{};
+    for (size_t i = 0; i < HNET_PACKET_SIZE_CLASS_COUNT; i++) {
+        size_t objectSize = static_cast<size_t>(1) << (i + HNET_PACKET_SIZE_CLASS_MIN_SHIFT);
+        size_t chunkCapacity = HNET_PACKET_POOL_CHUNK_SIZE / objectSize;
+        hnet_pool_initialize(pPools->pools[i], objectSize, chunkCapacity < 4 ? 4 : chunkCapacity);
+    }
+    s_packetPools.push_back(pPools);
+    return pPools;
+}
+
+static void* hnet_packet_acquire(HNetPacketPools& pools, uint8_t sizeClass)
+{
+    HNetPool& pool = pools.pools[sizeClass];
+    if (pool.freeList == nullptr) {
+        void* pObject = pools.remoteFrees[sizeClass].exchange(nullptr, std::memory_order_acquire);
+        while (pObject != nullptr) {
+            void* pNext = *static_cast<void**>(pObject);
+            hnet_pool_release(pool, pObject);
+            pObject = pNext;
+        }
+    }
+    return hnet_pool_acquire(pool);
+}
+
+static void hnet_packet_release(HNetPacketPools& pools, uint8_t sizeClass, void* pObject)
+{
+    if (&pools == t_packetPools) {
+        hnet_pool_release(pools.pools[sizeClass], pObject);
+        return;
+    }
+
+    std::atomic<void*>& head = pools.remoteFrees[sizeClass];
+    void* pNext = head.load(std::memory_order_relaxed);
+    do {
+        *static_cast<void**>(pObject) = pNext;
+    } while (!head.compare_exchange_weak(pNext, pObject, std::memory_order_release, std::memory_order_relaxed));
+}
+
+static uint8_t hnet_packet_size_class(size_t size)
+{
+    uint8_t sizeClass = 0;
+    while ((static_cast<size_t>(1) << (sizeClass + HNET_PACKET_SIZE_CLASS_MIN_SHIFT)) < size) {
+        if (++sizeClass >= HNET_PACKET_SIZE_CLASS_COUNT) {
+            return HNET_PACKET_SIZE_CLASS_NONE;
+        }
+    }
+    return sizeClass;
+}
 
 HNetPacket* hnet_packet_create(uint8_t* pData, size_t dataLength, uint32_t flags)
 {
-    HNetPacket* pPacket = static_cast<HNetPacket*>(hnet_malloc(sizeof(HNetPacket)));
+    if (t_packetPools == nullptr) {
+        t_packetPools = hnet_packet_attach_pools();
+    }
+
+    size_t blockSize = sizeof(HNetPacket);
+    if (!(flags & HNET_PACKET_FLAG_NO_ALLOCATE)) {
+        blockSize += dataLength;
+    }
+
+    uint8_t sizeClass = hnet_packet_size_class(blockSize);
+    HNetPacket* pPacket;
+    if (sizeClass != HNET_PACKET_SIZE_CLASS_NONE) {
+        pPacket = static_cast<HNetPacket*>(hnet_packet_acquire(*t_packetPools, sizeClass));
+    } else {
+        pPacket = static_cast<HNetPacket*>(hnet_malloc(blockSize));
+    }
     if (pPacket == nullptr) {
         return nullptr;
     }
@@ -13,11 +111,7 @@ HNetPacket* hnet_packet_create(uint8_t* pData, size_t dataLength, uint32_t flags
     } else if (dataLength <= 0) {
         pPacket->data = nullptr;
     } else {
-        pPacket->data = static_cast<uint8_t*>(hnet_malloc(dataLength));
-        if (pPacket->data == nullptr) {
-            hnet_free(pPacket);
-            return nullptr;
-        }
+        pPacket->data = reinterpret_cast<uint8_t*>(pPacket + 1);
         if (pData != nullptr) {
             memcpy(pPacket->data, pData, dataLength);
         }
@@ -25,9 +119,25 @@ HNetPacket* hnet_packet_create(uint8_t* pData, size_t dataLength, uint32_t flags
 
     pPacket->refCount = 0;
     pPacket->flags = flags;
+    pPacket->sizeClass = sizeClass;
+    pPacket->pools = t_packetPools;
     pPacket->dataLength = dataLength;
     pPacket->freeCallback = nullptr;
     pPacket->userData = nullptr;
+    pPacket->parent = nullptr;
+    return pPacket;
+}
+
+// the view points into the parent's data and keeps it alive until the view is destroyed
+HNetPacket* hnet_packet_create_view(HNetPacket& parent, uint8_t* pData, size_t dataLength, uint32_t flags)
+{
+    HNetPacket* pPacket = hnet_packet_create(pData, dataLength, flags | HNET_PACKET_FLAG_NO_ALLOCATE);
+    if (pPacket == nullptr) {
+        return nullptr;
+    }
+
+    pPacket->parent = &parent;
+    ++parent.refCount;
     return pPacket;
 }
 
@@ -39,8 +149,40 @@ void hnet_packet_destroy(HNetPacket* pPacket)
     if (pPacket->freeCallback != nullptr) {
         (*pPacket->freeCallback)(pPacket);
     }
-    if (!(pPacket->flags & HNET_PACKET_FLAG_NO_ALLOCATE) && pPacket->data != nullptr) {
-        hnet_free(pPacket->data);
+
+    HNetPacket* pParent = pPacket->parent;
+    if (pPacket->sizeClass != HNET_PACKET_SIZE_CLASS_NONE) {
+        hnet_packet_release(*pPacket->pools, pPacket->sizeClass, pPacket);
+    } else {
+        hnet_free(pPacket);
+    }
+
+    if (pParent != nullptr && --pParent->refCount == 0) {
+        hnet_packet_destroy(pParent);
+    }
+}
+
+void hnet_packet_detach_pools()
+{
+    if (t_packetPools == nullptr) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(s_packetPoolsMutex);
+    t_packetPools->next = s_detachedPools;
+    s_detachedPools = t_packetPools;
+    t_packetPools = nullptr;
+}
+
+void hnet_packet_finalize_pools()
+{
+    std::lock_guard<std::mutex> lock(s_packetPoolsMutex);
+    for (HNetPacketPools* pPools : s_packetPools) {
+        for (size_t i = 0; i < HNET_PACKET_SIZE_CLASS_COUNT; i++) {
+            hnet_pool_finalize(pPools->pools[i]);
+        }
+        delete pPools;
     }
-    hnet_free(pPacket);
-}
\ No newline at end of file
+    s_packetPools.clear();
+    s_detachedPools = nullptr;
+    t_packetPools = nullptr;
+}
@@ -3,10 +3,11 @@
 #include "host.h"
 #include "packet.h"
 #include "peer.h"
+#include "pool.h"
 #include "protocol.h"
 #include "socket.h"
 
-static void hnet_peer_reset_outgoing_commands(HNetList& queue)
+static void hnet_peer_reset_outgoing_commands(HNetPeer& peer, HNetList& queue)
 {
     while (!queue.empty()) {
         HNetListNode* pNode = queue.remove(queue.front());
@@ -17,11 +18,11 @@ static void hnet_peer_reset_outgoing_commands(HNetList& queue)
                 hnet_packet_destroy(cmd.packet);
             }
         }
-        hnet_free(&cmd);
+        hnet_pool_release(peer.host->outgoingCommandPool, &cmd);
     }
 }
 
-static void hnet_peer_remove_incoming_commands(HNetList& queue, HNetListNode* pStart, HNetListNode* pEnd)
+static void hnet_peer_remove_incoming_commands(HNetPeer& peer, HNetList& queue, HNetListNode* pStart, HNetListNode* pEnd, HNetIncomingCommand* pExclude)
 {
     if (pStart == nullptr || pEnd == nullptr) {
         return;
@@ -30,8 +31,15 @@ static void hnet_peer_remove_incoming_commands(HNetList& queue, HNetListNode* pS
     for (HNetListNode* pNode = pStart; pNode != pEnd; ) {
         HNetIncomingCommand& cmd = *reinterpret_cast<HNetIncomingCommand*>(pNode);
         pNode = pNode->next;
+        if (&cmd == pExclude) {
+            continue;
+        }
         HNetList::remove(&cmd.incomingCommandList);
         if (cmd.packet != nullptr) {
+            peer.totalWaitingData -= cmd.packet->dataLength;
+            if (cmd.fragmentsRemaining > 0 && (cmd.command.header.command & HNET_PROTOCOL_COMMAND_MASK) == HNET_PROTOCOL_COMMAND_SEND_UNRELIABLE_FRAGMENT) {
+                peer.unreliableFragmentData -= cmd.packet->dataLength;
+            }
             size_t refCount = --cmd.packet->refCount;
             if (refCount == 0) {
                 hnet_packet_destroy(cmd.packet);
@@ -40,18 +48,18 @@ static void hnet_peer_remove_incoming_commands(HNetList& queue, HNetListNode* pS
         if (cmd.fragments != nullptr) {
             hnet_free(cmd.fragments);
         }
-        hnet_free(&cmd);
+        hnet_pool_release(peer.host->incomingCommandPool, &cmd);
     }
 }
 
-static void hnet_peer_reset_incoming_commands(HNetList& queue)
+static void hnet_peer_reset_incoming_commands(HNetPeer& peer, HNetList& queue)
 {
-    hnet_peer_remove_incoming_commands(queue, queue.begin(), queue.end());
+    hnet_peer_remove_incoming_commands(peer, queue, queue.begin(), queue.end(), nullptr);
 }
 
 static void hnet_peer_setup_outgoing_command(HNetPeer& peer, HNetOutgoingCommand& cmd)
 {
-    peer.outgoingDataTotal += hnet_protocol_command_size(cmd.command.header.command);
+    peer.outgoingDataTotal += hnet_protocol_command_size(cmd.command.header.command) + cmd.fragmentLength;
 
     if (cmd.command.header.channelId == 0xFF) {
         ++peer.outgoingReliableSeqNumber;
@@ -99,34 +107,84 @@ static void hnet_peer_setup_outgoing_command(HNetPeer& peer, HNetOutgoingCommand
     } else {
         peer.outgoingUnreliableCommands.push_back(&cmd.outgoingCommandList);
     }
+    hnet_peer_queue_send(peer);
 }
 
 static HNetListNode* hnet_peer_find_incoming_current_command(HNetPeer& peer, const HNetProtocol& cmd)
 {
     HNetChannel& channel = peer.channels[cmd.header.channelId];
     HNetProtocolCommand type = static_cast<HNetProtocolCommand>(cmd.header.command & HNET_PROTOCOL_COMMAND_MASK);
+    uint16_t reliableSeqNumber = cmd.header.reliableSeqNumber;
+
+    if (type != HNET_PROTOCOL_COMMAND_SEND_UNSEQUENCED) {
+        uint16_t reliableWindow = reliableSeqNumber / HNET_PEER_RELIABLE_WINDOW_SIZE;
+        uint16_t currentWindow = channel.incomingReliableSeqNumber / HNET_PEER_RELIABLE_WINDOW_SIZE;
+        if (reliableSeqNumber < channel.incomingReliableSeqNumber) {
+            reliableWindow += HNET_PEER_RELIABLE_WINDOWS;
+        }
+        if (reliableWindow < currentWindow || reliableWindow >= currentWindow + HNET_PEER_FREE_RELIABLE_WINDOWS - 1) {
+            return nullptr;
+        }
+    }
 
     switch (type) {
     case HNET_PROTOCOL_COMMAND_SEND_RELIABLE:
     case HNET_PROTOCOL_COMMAND_SEND_FRAGMENT:
-        if (cmd.header.reliableSeqNumber <= channel.incomingReliableSeqNumber) {
+        if (reliableSeqNumber == channel.incomingReliableSeqNumber) {
             return nullptr;
         }
         for (HNetListNode* pNode = channel.incomingReliableCommands.back(); pNode != channel.incomingReliableCommands.end(); pNode = pNode->prev) {
             HNetIncomingCommand* pCmd = reinterpret_cast<HNetIncomingCommand*>(pNode);
-            if (pCmd->reliableSeqNumber == cmd.header.reliableSeqNumber) {
-                return nullptr;
-            }
-            if (cmd.header.reliableSeqNumber > pCmd->reliableSeqNumber) {
+            if (reliableSeqNumber >= channel.incomingReliableSeqNumber) {
+                if (pCmd->reliableSeqNumber < channel.incomingReliableSeqNumber) {
+                    continue;
+                }
+            } else if (pCmd->reliableSeqNumber >= channel.incomingReliableSeqNumber) {
                 return pNode;
             }
+            if (pCmd->reliableSeqNumber <= reliableSeqNumber) {
+                if (pCmd->reliableSeqNumber < reliableSeqNumber) {
+                    return pNode;
+                }
+                return nullptr;
+            }
         }
         return channel.incomingReliableCommands.end();
 
     case HNET_PROTOCOL_COMMAND_SEND_UNRELIABLE:
     case HNET_PROTOCOL_COMMAND_SEND_UNRELIABLE_FRAGMENT:
-        // unrealiable command is not supported.
-        return nullptr;
+    {
+        uint16_t unreliableSeqNumber = HNET_NET_TO_HOST_16(cmd.sendUnreliable.unreliableSeqNumber);
+        if (reliableSeqNumber == channel.incomingReliableSeqNumber && unreliableSeqNumber <= channel.incomingUnreliableSeqNumber) {
+            return nullptr;
+        }
+        for (HNetListNode* pNode = channel.incomingUnreliableCommands.back(); pNode != channel.incomingUnreliableCommands.end(); pNode = pNode->prev) {
+            HNetIncomingCommand* pCmd = reinterpret_cast<HNetIncomingCommand*>(pNode);
+            if ((pCmd->command.header.command & HNET_PROTOCOL_COMMAND_MASK) == HNET_PROTOCOL_COMMAND_SEND_UNSEQUENCED) {
+                continue;
+            }
+            if (reliableSeqNumber >= channel.incomingReliableSeqNumber) {
+                if (pCmd->reliableSeqNumber < channel.incomingReliableSeqNumber) {
+                    continue;
+                }
+            } else if (pCmd->reliableSeqNumber >= channel.incomingReliableSeqNumber) {
+                return pNode;
+            }
+            if (pCmd->reliableSeqNumber < reliableSeqNumber) {
+                return pNode;
+            }
+            if (pCmd->reliableSeqNumber > reliableSeqNumber) {
+                continue;
+            }
+            if (pCmd->unreliableSeqNumber <= unreliableSeqNumber) {
+                if (pCmd->unreliableSeqNumber < unreliableSeqNumber) {
+                    return pNode;
+                }
+                return nullptr;
+            }
+        }
+        return channel.incomingUnreliableCommands.end();
+    }
 
     case HNET_PROTOCOL_COMMAND_SEND_UNSEQUENCED:
         return channel.incomingUnreliableCommands.end();
@@ -136,28 +194,85 @@ static HNetListNode* hnet_peer_find_incoming_current_command(HNetPeer& peer, con
     }
 }
 
-static void hnet_peer_dispatch_incoming_unreliable_commands(HNetPeer& peer, HNetChannel& channel)
+static void hnet_peer_dispatch_commands(HNetPeer& peer, HNetListNode* pFirst, HNetListNode* pLast)
 {
-    // unrelilable command is not supported.
-    HNetListNode* pStartNode = channel.incomingUnreliableCommands.begin();
-    HNetListNode* pCurrentNode = channel.incomingUnreliableCommands.end();
-
-    peer.dispatchedCommands.push_back(pStartNode, pCurrentNode->prev);
+    peer.dispatchedCommands.push_back(pFirst, pLast);
     if (!peer.needsDispatch) {
         peer.host->dispatchQueue.push_back(&peer.dispatchList);
         peer.needsDispatch = true;
     }
-    HNetListNode* pDroppedNode = pCurrentNode;
-    hnet_peer_remove_incoming_commands(channel.incomingUnreliableCommands, channel.incomingUnreliableCommands.begin(), pDroppedNode);
 }
 
-static void hnet_peer_dispatch_incoming_reliable_commands(HNetPeer& peer, HNetChannel& channel)
+void hnet_peer_dispatch_incoming_unreliable_commands(HNetPeer& peer, HNetChannel& channel, HNetIncomingCommand* pQueuedCmd)
+{
+    HNetList& queue = channel.incomingUnreliableCommands;
+    HNetListNode* pDroppedNode = queue.begin();
+    HNetListNode* pStartNode = queue.begin();
+    HNetListNode* pNode = queue.begin();
+
+    for (; pNode != queue.end(); pNode = pNode->next) {
+        HNetIncomingCommand* pCmd = reinterpret_cast<HNetIncomingCommand*>(pNode);
+        if ((pCmd->command.header.command & HNET_PROTOCOL_COMMAND_MASK) == HNET_PROTOCOL_COMMAND_SEND_UNSEQUENCED) {
+            continue;
+        }
+
+        if (pCmd->reliableSeqNumber == channel.incomingReliableSeqNumber) {
+            if (pCmd->fragmentsRemaining == 0) {
+                channel.incomingUnreliableSeqNumber = pCmd->unreliableSeqNumber;
+                continue;
+            }
+            if (pStartNode != pNode) {
+                hnet_peer_dispatch_commands(peer, pStartNode, pNode->prev);
+                pDroppedNode = pNode;
+            } else if (pDroppedNode != pNode) {
+                pDroppedNode = pNode->prev;
+            }
+        } else {
+            uint16_t reliableWindow = pCmd->reliableSeqNumber / HNET_PEER_RELIABLE_WINDOW_SIZE;
+            uint16_t currentWindow = channel.incomingReliableSeqNumber / HNET_PEER_RELIABLE_WINDOW_SIZE;
+            if (pCmd->reliableSeqNumber < channel.incomingReliableSeqNumber) {
+                reliableWindow += HNET_PEER_RELIABLE_WINDOWS;
+            }
+            if (reliableWindow >= currentWindow && reliableWindow < currentWindow + HNET_PEER_FREE_RELIABLE_WINDOWS - 1) {
+                break;
+            }
+
+            pDroppedNode = pNode->next;
+            if (pStartNode != pNode) {
+                hnet_peer_dispatch_commands(peer, pStartNode, pNode->prev);
+            }
+        }
+
+        pStartNode = pNode->next;
+    }
+
+    if (pStartNode != pNode) {
+        hnet_peer_dispatch_commands(peer, pStartNode, pNode->prev);
+        pDroppedNode = pNode;
+    }
+
+    hnet_peer_remove_incoming_commands(peer, queue, queue.begin(), pDroppedNode, pQueuedCmd);
+}
+
+void hnet_peer_remove_unreliable_fragments(HNetPeer& peer, HNetChannel& channel)
+{
+    HNetList& queue = channel.incomingUnreliableCommands;
+    for (HNetListNode* pNode = queue.begin(); pNode != queue.end(); ) {
+        HNetIncomingCommand* pCmd = reinterpret_cast<HNetIncomingCommand*>(pNode);
+        pNode = pNode->next;
+        if (pCmd->fragmentsRemaining > 0) {
+            hnet_peer_remove_incoming_commands(peer, queue, &pCmd->incomingCommandList, pNode, nullptr);
+        }
+    }
+}
+
+void hnet_peer_dispatch_incoming_reliable_commands(HNetPeer& peer, HNetChannel& channel)
 {
     HNetListNode* pNode = nullptr;
 
     for (pNode = channel.incomingReliableCommands.begin(); pNode != channel.incomingReliableCommands.end(); pNode = pNode->next) {
         HNetIncomingCommand* pCmd = reinterpret_cast<HNetIncomingCommand*>(pNode);
-        if (pCmd->fragmentCount > 0 || pCmd->reliableSeqNumber != (channel.incomingReliableSeqNumber + 1)) {
+        if (pCmd->fragmentsRemaining > 0 || pCmd->reliableSeqNumber != static_cast<uint16_t>(channel.incomingReliableSeqNumber + 1)) {
             break;
         }
 
@@ -174,15 +289,10 @@ static void hnet_peer_dispatch_incoming_reliable_commands(HNetPeer& peer, HNetCh
 
     channel.incomingUnreliableSeqNumber = 0;
 
-    peer.dispatchedCommands.push_back(channel.incomingReliableCommands.begin(), pNode->prev);
-
-    if (!peer.needsDispatch) {
-        peer.host->dispatchQueue.push_back(&peer.dispatchList);
-        peer.needsDispatch = true;
-    }
+    hnet_peer_dispatch_commands(peer, channel.incomingReliableCommands.begin(), pNode->prev);
 
     if (!channel.incomingUnreliableCommands.empty()) {
-        hnet_peer_dispatch_incoming_unreliable_commands(peer, channel);
+        hnet_peer_dispatch_incoming_unreliable_commands(peer, channel, nullptr);
     }
 }
 
@@ -242,6 +352,8 @@ void hnet_peer_disconnect(HNetPeer& peer, uint32_t data)
 void hnet_peer_reset(HNetPeer& peer)
 {
     hnet_peer_on_disconnect(peer);
+    hnet_host_unschedule_peer(*peer.host, peer);
+    hnet_host_release_peer(*peer.host, peer);
     peer.outgoingPeerId = HNET_PROTOCOL_MAX_PEER_ID;
     peer.connectId = 0;
     peer.state = HNetPeerState::Disconnected;
@@ -267,6 +379,8 @@ void hnet_peer_reset(HNetPeer& peer)
     peer.packetThrottleAcceleration = HNET_PEER_PACKET_THROTTLE_ACCELERATION;
     peer.packetThrottleDeceleration = HNET_PEER_PACKET_THROTTLE_DECELERATION;
     peer.packetThrottleInterval = HNET_PEER_PACKET_THROTTLE_INTERVAL;
+    peer.unreliablePacketsSent = 0;
+    peer.unreliablePacketsThrottled = 0;
     peer.pingInterval = HNET_PEER_PING_INTERVAL;
     peer.timeoutLimit = HNET_PEER_TIMEOUT_LIMIT;
     peer.timeoutMin = HNET_PEER_TIMEOUT_MIN;
@@ -279,14 +393,17 @@ void hnet_peer_reset(HNetPeer& peer)
     peer.roundTripTimeVariance = 0;
     peer.mtu = peer.host->mtu;
     peer.reliableDataInTransit = 0;
+    peer.reliableWindowStalled = false;
     peer.outgoingReliableSeqNumber = 0;
     peer.windowSize = HNET_PROTOCOL_MAX_WINDOW_SIZE;
+    peer.selectiveAcks = false;
     peer.incomingUnseqGroup = 0;
     peer.outgoingUnseqGroup = 0;
     peer.eventData = 0;
-    peer.totalWaitingData = 0;
     memset(peer.unseqWindow, 0, sizeof(peer.unseqWindow));
     hnet_peer_reset_queues(peer);
+    peer.totalWaitingData = 0;
+    peer.unreliableFragmentData = 0;
 }
 
 void hnet_peer_reset_queues(HNetPeer& peer)
@@ -296,32 +413,40 @@ void hnet_peer_reset_queues(HNetPeer& peer)
         peer.needsDispatch = false;
     }
 
+    if (peer.needsSend) {
+        HNetList::remove(&peer.sendList);
+        peer.needsSend = false;
+    }
+
     while (!peer.acks.empty()) {
         HNetListNode* pNode = peer.acks.front();
         HNetList::remove(pNode);
-        hnet_free(pNode);
+        hnet_pool_release(peer.host->ackPool, pNode);
     }
+    peer.ackChannels.clear();
 
-    hnet_peer_reset_outgoing_commands(peer.sentReliableCommands);
-    hnet_peer_reset_outgoing_commands(peer.sentUnreliableCommands);
-    hnet_peer_reset_outgoing_commands(peer.outgoingReliableCommands);
-    hnet_peer_reset_outgoing_commands(peer.outgoingUnreliableCommands);
-    hnet_peer_reset_incoming_commands(peer.dispatchedCommands);
+    hnet_peer_reset_outgoing_commands(peer, peer.sentReliableCommands);
+    hnet_peer_reset_outgoing_commands(peer, peer.sentUnreliableCommands);
+    hnet_peer_reset_outgoing_commands(peer, peer.outgoingReliableCommands);
+    hnet_peer_reset_outgoing_commands(peer, peer.outgoingUnreliableCommands);
+    hnet_peer_reset_incoming_commands(peer, peer.dispatchedCommands);
 
     for (size_t i = 0; i < peer.channelCount; i++) {
         HNetChannel& channel = peer.channels[i];
-        hnet_peer_reset_incoming_commands(channel.incomingReliableCommands);
-        hnet_peer_reset_incoming_commands(channel.incomingUnreliableCommands);
+        hnet_peer_reset_incoming_commands(peer, channel.incomingReliableCommands);
+        hnet_peer_reset_incoming_commands(peer, channel.incomingUnreliableCommands);
     }
 
     if (peer.channels != nullptr) {
         hnet_free(peer.channels);
+        peer.channels = nullptr;
+        peer.channelCount = 0;
     }
 }
 
 bool hnet_peer_queue_outgoing_command(HNetPeer& peer, const HNetProtocol& cmd, HNetPacket* pPacket, uint32_t offset, uint16_t length)
 {
-    HNetOutgoingCommand* pCmd = static_cast<HNetOutgoingCommand*>(hnet_malloc(sizeof(HNetOutgoingCommand)));
+    HNetOutgoingCommand* pCmd = static_cast<HNetOutgoingCommand*>(hnet_pool_acquire(peer.host->outgoingCommandPool));
     if (pCmd == nullptr) {
         return false;
     }
@@ -338,31 +463,38 @@ bool hnet_peer_queue_outgoing_command(HNetPeer& peer, const HNetProtocol& cmd, H
     return true;
 }
 
-bool hnet_peer_queue_incoming_command(HNetPeer& peer, const HNetProtocol& cmd, uint8_t* pData, size_t dataLength, uint32_t flags, uint32_t fragmentCount)
+HNetIncomingCommand* hnet_peer_queue_incoming_command(HNetPeer& peer, const HNetProtocol& cmd, uint8_t* pData, size_t dataLength, uint32_t flags, uint32_t fragmentCount)
 {
-    // fragment is not supported.
-    if (peer.state == HNetPeerState::DisconnectLater) {
-        return false;
-    }
+    static HNetIncomingCommand dummyCommand;
 
-    HNetListNode* pCurrent = hnet_peer_find_incoming_current_command(peer, cmd);
+    HNetListNode* pCurrent = nullptr;
+    if (peer.state != HNetPeerState::DisconnectLater) {
+        pCurrent = hnet_peer_find_incoming_current_command(peer, cmd);
+    }
     if (pCurrent == nullptr) {
-        return false;
+        return fragmentCount > 0 ? nullptr : &dummyCommand;
     }
 
     if (peer.totalWaitingData >= peer.host->maxWaitingData) {
-        return false;
+        return nullptr;
     }
 
-    HNetPacket* pPacket = hnet_packet_create(pData, dataLength, flags);
+    HNetHost& host = *peer.host;
+    HNetPacket* pPacket;
+    if (fragmentCount == 0 && dataLength >= HNET_HOST_ZERO_COPY_THRESHOLD && host.recvPacket != nullptr &&
+        pData >= host.recvData && pData + dataLength <= host.recvData + host.recvDataLength) {
+        pPacket = hnet_packet_create_view(*host.recvPacket, pData, dataLength, flags);
+    } else {
+        pPacket = hnet_packet_create(pData, dataLength, flags);
+    }
     if (pPacket == nullptr) {
-        return false;
+        return nullptr;
     }
 
-    HNetIncomingCommand* pCmd = static_cast<HNetIncomingCommand*>(hnet_malloc(sizeof(HNetIncomingCommand)));
+    HNetIncomingCommand* pCmd = static_cast<HNetIncomingCommand*>(hnet_pool_acquire(peer.host->incomingCommandPool));
     if (pCmd == nullptr) {
         hnet_packet_destroy(pPacket);
-        return false;
+        return nullptr;
     }
 
     pCmd->reliableSeqNumber = cmd.header.reliableSeqNumber;
@@ -373,8 +505,22 @@ bool hnet_peer_queue_incoming_command(HNetPeer& peer, const HNetProtocol& cmd, u
     pCmd->packet = pPacket;
     pCmd->fragments = nullptr;
 
+    if (fragmentCount > 0) {
+        size_t fragmentsSize = (fragmentCount + 31) / 32 * sizeof(uint32_t);
+        pCmd->fragments = static_cast<uint32_t*>(hnet_malloc(fragmentsSize));
+        if (pCmd->fragments == nullptr) {
+            hnet_pool_release(peer.host->incomingCommandPool, pCmd);
+            hnet_packet_destroy(pPacket);
+            return nullptr;
+        }
+        memset(pCmd->fragments, 0, fragmentsSize);
+    }
+
     ++pPacket->refCount;
     peer.totalWaitingData += pPacket->dataLength;
+    if (fragmentCount > 0 && (cmd.header.command & HNET_PROTOCOL_COMMAND_MASK) == HNET_PROTOCOL_COMMAND_SEND_UNRELIABLE_FRAGMENT) {
+        peer.unreliableFragmentData += pPacket->dataLength;
+    }
 
     HNetList::insert(pCurrent->next, &pCmd->incomingCommandList);
     HNetChannel& channel = peer.channels[cmd.header.channelId];
@@ -386,15 +532,63 @@ bool hnet_peer_queue_incoming_command(HNetPeer& peer, const HNetProtocol& cmd, u
         break;
 
     default:
-        hnet_peer_dispatch_incoming_unreliable_commands(peer, channel);
+        hnet_peer_dispatch_incoming_unreliable_commands(peer, channel, pCmd);
         break;
     }
+    return pCmd;
+}
+
+static bool hnet_peer_spill_selective_ack(HNetPeer& peer, HNetChannel& channel)
+{
+    HNetAck* pAck = static_cast<HNetAck*>(hnet_pool_acquire(peer.host->ackPool));
+    if (pAck == nullptr) {
+        return false;
+    }
+
+    pAck->sentTime = channel.ackSentTime;
+    pAck->command.header.command = HNET_PROTOCOL_COMMAND_SELECTIVE_ACKNOWLEDGE;
+    pAck->command.header.channelId = static_cast<uint8_t>(&channel - peer.channels);
+    pAck->command.header.reliableSeqNumber = channel.ackBaseSeqNumber;
+    pAck->command.selectiveAck.ackBitmap = channel.ackBitmap;
+    peer.acks.push_back(&pAck->ackList);
+
+    HNetList::remove(&channel.ackList);
+    channel.ackBitmap = 0;
+    return true;
+}
+
+static bool hnet_peer_queue_selective_ack(HNetPeer& peer, HNetChannel& channel, uint16_t reliableSeqNumber, uint16_t sentTime)
+{
+    if (channel.ackBitmap != 0) {
+        uint16_t offset = reliableSeqNumber - channel.ackBaseSeqNumber;
+        if (offset < HNET_PROTOCOL_SACK_WINDOW_SIZE) {
+            channel.ackBitmap |= 1u << offset;
+            channel.ackSentTime = sentTime;
+            hnet_peer_queue_send(peer);
+            return true;
+        }
+        // out of reach of the current window; park it and start a new one
+        if (!hnet_peer_spill_selective_ack(peer, channel)) {
+            return false;
+        }
+    }
+
+    peer.outgoingDataTotal += sizeof(HNetProtocolSelectiveAck);
+    channel.ackBaseSeqNumber = reliableSeqNumber;
+    channel.ackSentTime = sentTime;
+    channel.ackBitmap = 1;
+    peer.ackChannels.push_back(&channel.ackList);
+    hnet_peer_queue_send(peer);
     return true;
 }
 
 bool hnet_peer_queue_ack(HNetPeer& peer, const HNetProtocol& cmd, uint16_t sentTime)
 {
-    HNetAck* pAck = static_cast<HNetAck*>(hnet_malloc(sizeof(HNetAck)));
+    if (peer.selectiveAcks && cmd.header.channelId < peer.channelCount) {
+        return hnet_peer_queue_selective_ack(peer, peer.channels[cmd.header.channelId], cmd.header.reliableSeqNumber, sentTime);
+    }
+
+    HNetAck* pAck = static_cast<HNetAck*>(hnet_pool_acquire(peer.host->ackPool));
     if (pAck == nullptr) {
         return false;
     }
@@ -403,9 +597,23 @@ bool hnet_peer_queue_ack(HNetPeer& peer, const HNetProtocol& cmd, uint16_t sentT
     pAck->sentTime = sentTime;
     pAck->command = cmd;
     peer.acks.push_back(&pAck->ackList);
+    hnet_peer_queue_send(peer);
     return true;
 }
 
+void hnet_peer_queue_send(HNetPeer& peer)
+{
+    if (!peer.needsSend) {
+        peer.host->sendQueue.push_back(&peer.sendList);
+        peer.needsSend = true;
+    }
+}
+
+HNetPeer* hnet_peer_from_send_list(HNetListNode* pNode)
+{
+    return reinterpret_cast<HNetPeer*>(reinterpret_cast<uint8_t*>(pNode) - offsetof(HNetPeer, sendList));
+}
+
 void hnet_peer_throttle(HNetPeer& peer, uint32_t rtt)
 {
     if (peer.lastRoundTripTime <= peer.lastRoundTripTimeVariance) {
@@ -424,13 +632,75 @@ void hnet_peer_throttle(HNetPeer& peer, uint32_t rtt)
     }
 }
 
+static bool hnet_peer_send_fragments(HNetPeer& peer, uint8_t channelId, HNetPacket& packet, uint32_t fragmentLength)
+{
+    uint32_t fragmentCount = (packet.dataLength + fragmentLength - 1) / fragmentLength;
+    if (fragmentCount > HNET_PROTOCOL_MAX_FRAGMENT_COUNT) {
+        return false;
+    }
+
+    HNetChannel& channel = peer.channels[channelId];
+    uint8_t command = HNET_PROTOCOL_COMMAND_SEND_FRAGMENT | HNET_PROTOCOL_COMMAND_FLAG_ACKNOWLEDGE;
+    uint16_t startSeqNumber = HNET_HOST_TO_NET_16(static_cast<uint16_t>(channel.outgoingReliableSeqNumber + 1));
+    if ((packet.flags & (HNET_PACKET_FLAG_RELIABLE | HNET_PACKET_FLAG_UNRELIABLE_FRAGMENT)) == HNET_PACKET_FLAG_UNRELIABLE_FRAGMENT &&
+        channel.outgoingUnreliableSeqNumber < 0xFFFF) {
+        command = HNET_PROTOCOL_COMMAND_SEND_UNRELIABLE_FRAGMENT;
+        startSeqNumber = HNET_HOST_TO_NET_16(static_cast<uint16_t>(channel.outgoingUnreliableSeqNumber + 1));
+    }
+
+    HNetList fragments;
+    uint32_t fragmentNumber = 0;
+    for (uint32_t fragmentOffset = 0; fragmentOffset < packet.dataLength; fragmentNumber++, fragmentOffset += fragmentLength) {
+        if (packet.dataLength - fragmentOffset < fragmentLength) {
+            fragmentLength = packet.dataLength - fragmentOffset;
+        }
+
+        HNetOutgoingCommand* pFragment = static_cast<HNetOutgoingCommand*>(hnet_pool_acquire(peer.host->outgoingCommandPool));
+        if (pFragment == nullptr) {
+            while (!fragments.empty()) {
+                hnet_pool_release(peer.host->outgoingCommandPool, HNetList::remove(fragments.begin()));
+            }
+            return false;
+        }
+
+        pFragment->fragmentOffset = fragmentOffset;
+        pFragment->fragmentLength = fragmentLength;
+        pFragment->packet = &packet;
+        pFragment->command.header.command = command;
+        pFragment->command.header.channelId = channelId;
+        pFragment->command.sendFragment.startSeqNumber = startSeqNumber;
+        pFragment->command.sendFragment.dataLength = HNET_HOST_TO_NET_16(fragmentLength);
+        pFragment->command.sendFragment.fragmentCount = HNET_HOST_TO_NET_32(fragmentCount);
+        pFragment->command.sendFragment.fragmentNumber = HNET_HOST_TO_NET_32(fragmentNumber);
+        pFragment->command.sendFragment.totalLength = HNET_HOST_TO_NET_32(packet.dataLength);
+        pFragment->command.sendFragment.fragmentOffset = HNET_HOST_TO_NET_32(fragmentOffset);
+        fragments.push_back(&pFragment->outgoingCommandList);
+    }
+
+    packet.refCount += fragmentNumber;
+
+    while (!fragments.empty()) {
+        HNetOutgoingCommand* pFragment = reinterpret_cast<HNetOutgoingCommand*>(HNetList::remove(fragments.begin()));
+        hnet_peer_setup_outgoing_command(peer, *pFragment);
+    }
+
+    return true;
+}
+
 bool hnet_peer_send(HNetPeer& peer, uint8_t channelId, HNetPacket& packet)
 {
-    // fragment is not supported.
     if (peer.state != HNetPeerState::Connected || channelId >= peer.channelCount || packet.dataLength > peer.host->maxPacketSize) {
         return false;
     }
 
+    uint32_t fragmentLength = peer.mtu - sizeof(HNetProtocolHeader) - sizeof(HNetProtocolSendFragment);
+    if (peer.host->checksum != nullptr) {
+        fragmentLength -= sizeof(uint32_t);
+    }
+    if (packet.dataLength > fragmentLength) {
+        return hnet_peer_send_fragments(peer, channelId, packet, fragmentLength);
+    }
+
     HNetChannel& channel = peer.channels[channelId];
     HNetProtocol cmd;
     cmd.header.channelId = channelId;
@@ -442,7 +712,7 @@ bool hnet_peer_send(HNetPeer& peer, uint8_t channelId, HNetPacket& packet)
         cmd.header.command = HNET_PROTOCOL_COMMAND_SEND_RELIABLE | HNET_PROTOCOL_COMMAND_FLAG_ACKNOWLEDGE;
         cmd.sendReliable.dataLength = HNET_HOST_TO_NET_16(packet.dataLength);
     } else {
-        cmd.header.command = HNET_PROTOCOL_COMMAND_SEND_UNSEQUENCED;
+        cmd.header.command = HNET_PROTOCOL_COMMAND_SEND_UNRELIABLE;
         cmd.sendUnreliable.dataLength = HNET_HOST_TO_NET_16(packet.dataLength);
     }
 
@@ -453,6 +723,17 @@ bool hnet_peer_send(HNetPeer& peer, uint8_t channelId, HNetPacket& packet)
     return true;
 }
 
+bool hnet_peer_send_async(HNetPeer& peer, uint32_t connectId, uint8_t channelId, HNetPacket& packet)
+{
+    // peer.host and incomingPeerId never change; the session and state checks wait for the host thread
+    HNetAsyncSend send{&packet, connectId, peer.incomingPeerId, channelId};
+    if (!hnet_mpsc_ring_push(peer.host->asyncSends, send)) {
+        return false;
+    }
+    hnet_host_wakeup(*peer.host);
+    return true;
+}
+
 HNetPacket* hnet_peer_recv(HNetPeer& peer, uint8_t& channelId)
 {
     if (peer.dispatchedCommands.empty()) {
@@ -468,7 +749,7 @@ HNetPacket* hnet_peer_recv(HNetPeer& peer, uint8_t& channelId)
     if (cmd.fragments != nullptr) {
         hnet_free(cmd.fragments);
     }
-    hnet_free(&cmd);
+    hnet_pool_release(peer.host->incomingCommandPool, &cmd);
     peer.totalWaitingData -= pPacket->dataLength;
     return pPacket;
 }
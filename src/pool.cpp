@@ -0,0 +1,92 @@
+#include <stddef.h>
+#include <stdint.h>
+#include "allocator.h"
+#include "pool.h"
+
+struct HNetPoolChunk
+{
+    HNetPoolChunk* next;
+    void* memory;
+};
+
+static size_t hnet_pool_align(size_t size, size_t alignment)
+{
+    return (size + alignment - 1) & ~(alignment - 1);
+}
+
+static bool hnet_pool_grow(HNetPool& pool, size_t objectCount)
+{
+    size_t headerSize = hnet_pool_align(sizeof(HNetPoolChunk), HNET_POOL_CACHE_LINE_SIZE);
+    void* pMemory = hnet_malloc(HNET_POOL_CACHE_LINE_SIZE + headerSize + objectCount * pool.objectSize);
+    if (pMemory == nullptr) {
+        return false;
+    }
+
+    uint8_t* pBase = reinterpret_cast<uint8_t*>(hnet_pool_align(reinterpret_cast<uintptr_t>(pMemory), HNET_POOL_CACHE_LINE_SIZE));
+    HNetPoolChunk* pChunk = reinterpret_cast<HNetPoolChunk*>(pBase);
+    pChunk->memory = pMemory;
+    pChunk->next = pool.chunks;
+    pool.chunks = pChunk;
+
+    uint8_t* pObjects = pBase + headerSize;
+    for (size_t i = objectCount; i > 0; i--) {
+        void* pObject = pObjects + (i - 1) * pool.objectSize;
+        *static_cast<void**>(pObject) = pool.freeList;
+        pool.freeList = pObject;
+    }
+    pool.capacity += objectCount;
+
+    return true;
+}
+
+void hnet_pool_initialize(HNetPool& pool, size_t objectSize, size_t chunkCapacity)
+{
+    pool.objectSize = hnet_pool_align(objectSize < sizeof(void*) ? sizeof(void*) : objectSize, alignof(max_align_t));
+    pool.chunkCapacity = chunkCapacity > 0 ? chunkCapacity : HNET_POOL_DEFAULT_CHUNK_CAPACITY;
+    pool.chunks = nullptr;
+    pool.freeList = nullptr;
+    pool.capacity = 0;
+    pool.used = 0;
+    pool.highWater = 0;
+}
+
+void hnet_pool_finalize(HNetPool& pool)
+{
+    while (pool.chunks != nullptr) {
+        HNetPoolChunk* pChunk = pool.chunks;
+        pool.chunks = pChunk->next;
+        hnet_free(pChunk->memory);
+    }
+    pool.freeList = nullptr;
+    pool.capacity = 0;
+    pool.used = 0;
+}
+
+bool hnet_pool_reserve(HNetPool& pool, size_t count)
+{
+    if (pool.capacity >= count) {
+        return true;
+    }
+    return hnet_pool_grow(pool, count - pool.capacity);
+}
+
+void* hnet_pool_acquire(HNetPool& pool)
+{
+    if (pool.freeList == nullptr && !hnet_pool_grow(pool, pool.chunkCapacity)) {
+        return nullptr;
+    }
+
+    void* pObject = pool.freeList;
+    pool.freeList = *static_cast<void**>(pObject);
+    if (++pool.used > pool.highWater) {
+        pool.highWater = pool.used;
+    }
+    return pObject;
+}
+
+void hnet_pool_release(HNetPool& pool, void* ptr)
+{
+    *static_cast<void**>(ptr) = pool.freeList;
+    pool.freeList = ptr;
+    pool.used--;
+}
\ No newline at end of file
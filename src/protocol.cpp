@@ -23,6 +23,7 @@ static size_t commandSizes[HNET_PROTOCOL_COMMAND_COUNT] = {
     sizeof(HNetProtocolBandwidthLimit),
     sizeof(HNetProtocolThrottleConfigure),
     sizeof(HNetProtocolSendFragment),
+    sizeof(HNetProtocolSelectiveAck),
 };
 
 static void hnet_protocol_change_state(HNetPeer& peer, HNetPeerState state)
@@ -50,6 +51,7 @@ static void hnet_protocol_notify_connect(HNetHost& host, HNetPeer& peer, HNetEve
     hnet_protocol_change_state(peer, HNetPeerState::Connected);
     event.type = HNetEventType::Connect;
     event.peer = &peer;
+    event.connectId = peer.connectId;
     event.data = peer.eventData;
 }
 
@@ -63,6 +65,7 @@ static void hnet_protocol_notify_disconnect(HNetHost& host, HNetPeer& peer, HNet
     } else if (pEvent != nullptr) {
         pEvent->type = HNetEventType::Disconnect;
         pEvent->peer = &peer;
+        pEvent->connectId = peer.connectId;
         pEvent->data = 0;
         hnet_peer_reset(peer);
     } else {
@@ -76,6 +79,7 @@ static bool hnet_protocol_check_timeouts(HNetHost& host, HNetPeer& peer, HNetEve
     for (HNetListNode* pNode = peer.sentReliableCommands.begin(); pNode != peer.sentReliableCommands.end();) {
         HNetOutgoingCommand& cmd = *reinterpret_cast<HNetOutgoingCommand*>(pNode);
         if (HNET_TIME_DIFF(host.serviceTime, cmd.sentTime) < cmd.roundTripTimeout) {
+            pNode = pNode->next;
             continue;
         }
 
@@ -115,48 +119,132 @@ static bool hnet_protocol_check_timeouts(HNetHost& host, HNetPeer& peer, HNetEve
     return false;
 }
 
-static void hnet_protocol_send_acks(HNetHost& host, HNetPeer& peer)
+static void hnet_protocol_schedule_peer(HNetHost& host, HNetPeer& peer)
 {
-    for (HNetListNode* pNode = peer.acks.begin(); pNode != peer.acks.end();) {
-        if (host.commandCount >= HNET_PROTOCOL_MAX_PACKET_COMMANDS ||
-            host.bufferCount >= HNET_BUFFER_MAX ||
-            (peer.mtu - host.packetSize) < sizeof(HNetProtocolAck)) {
-            host.continueSending = true;
-            return;
-        }
+    if (peer.state == HNetPeerState::Disconnected || peer.state == HNetPeerState::Zombie) {
+        hnet_host_unschedule_peer(host, peer);
+    } else if (!peer.sentReliableCommands.empty()) {
+        hnet_host_schedule_peer(host, peer, peer.nextTimeout);
+    } else {
+        hnet_host_schedule_peer(host, peer, peer.lastRecvTime + peer.pingInterval);
+    }
+}
 
-        HNetProtocol& cmd = host.commands[host.commandCount++];
-        HNetBuffer& buffer = host.buffers[host.bufferCount++];
-        buffer.data = &cmd;
-        buffer.dataLength = sizeof(HNetProtocolAck);
-        host.packetSize += buffer.dataLength;
+static bool hnet_protocol_reserve_ack(HNetHost& host, HNetPeer& peer, size_t cmdSize, HNetProtocol*& pCmd)
+{
+    if (host.commandCount >= HNET_PROTOCOL_MAX_PACKET_COMMANDS ||
+        host.bufferCount >= HNET_BUFFER_MAX ||
+        (peer.mtu - host.packetSize) < cmdSize) {
+        host.continueSending = true;
+        return false;
+    }
 
-        HNetAck* pAck = reinterpret_cast<HNetAck*>(pNode);
-        cmd.header.command = HNET_PROTOCOL_COMMAND_ACKNOWLEDGE;
-        cmd.header.channelId = pAck->command.header.channelId;
-        cmd.header.reliableSeqNumber = HNET_HOST_TO_NET_16(pAck->command.header.reliableSeqNumber);
-        cmd.ack.recvReliableSeqNumber = HNET_HOST_TO_NET_16(pAck->command.header.reliableSeqNumber);
-        cmd.ack.recvSentTime = HNET_HOST_TO_NET_16(pAck->sentTime);
+    pCmd = &host.commands[host.commandCount++];
+    HNetBuffer& buffer = host.buffers[host.bufferCount++];
+    buffer.data = pCmd;
+    buffer.dataLength = cmdSize;
+    host.packetSize += buffer.dataLength;
+    return true;
+}
+
+static void hnet_protocol_init_selective_ack(HNetProtocol& cmd, uint8_t channelId, uint16_t baseSeqNumber, uint16_t sentTime, uint32_t ackBitmap)
+{
+    cmd.header.command = HNET_PROTOCOL_COMMAND_SELECTIVE_ACKNOWLEDGE;
+    cmd.header.channelId = channelId;
+    cmd.header.reliableSeqNumber = HNET_HOST_TO_NET_16(baseSeqNumber);
+    cmd.selectiveAck.recvSentTime = HNET_HOST_TO_NET_16(sentTime);
+    cmd.selectiveAck.ackBitmap = HNET_HOST_TO_NET_32(ackBitmap);
+}
 
-        if ((pAck->command.header.command & HNET_PROTOCOL_COMMAND_MASK) == HNET_PROTOCOL_COMMAND_DISCONNECT) {
-            hnet_protocol_dispatch_state(host, peer, HNetPeerState::Zombie);
+static void hnet_protocol_send_acks(HNetHost& host, HNetPeer& peer)
+{
+    for (HNetListNode* pNode = peer.acks.begin(); pNode != peer.acks.end();) {
+        HNetAck* pAck = reinterpret_cast<HNetAck*>(pNode);
+        HNetProtocol* pCmd = nullptr;
+        if ((pAck->command.header.command & HNET_PROTOCOL_COMMAND_MASK) == HNET_PROTOCOL_COMMAND_SELECTIVE_ACKNOWLEDGE) {
+            if (!hnet_protocol_reserve_ack(host, peer, sizeof(HNetProtocolSelectiveAck), pCmd)) {
+                return;
+            }
+            hnet_protocol_init_selective_ack(*pCmd, pAck->command.header.channelId, pAck->command.header.reliableSeqNumber, pAck->sentTime, pAck->command.selectiveAck.ackBitmap);
+        } else {
+            if (!hnet_protocol_reserve_ack(host, peer, sizeof(HNetProtocolAck), pCmd)) {
+                return;
+            }
+            HNetProtocol& cmd = *pCmd;
+            cmd.header.command = HNET_PROTOCOL_COMMAND_ACKNOWLEDGE;
+            cmd.header.channelId = pAck->command.header.channelId;
+            cmd.header.reliableSeqNumber = HNET_HOST_TO_NET_16(pAck->command.header.reliableSeqNumber);
+            cmd.ack.recvReliableSeqNumber = HNET_HOST_TO_NET_16(pAck->command.header.reliableSeqNumber);
+            cmd.ack.recvSentTime = HNET_HOST_TO_NET_16(pAck->sentTime);
+
+            if ((pAck->command.header.command & HNET_PROTOCOL_COMMAND_MASK) == HNET_PROTOCOL_COMMAND_DISCONNECT) {
+                hnet_protocol_dispatch_state(host, peer, HNetPeerState::Zombie);
+            }
         }
 
         pNode = pNode->next;
         HNetList::remove(&pAck->ackList);
-        hnet_free(pAck);
+        hnet_pool_release(host.ackPool, pAck);
+    }
+
+    while (!peer.ackChannels.empty()) {
+        HNetProtocol* pCmd = nullptr;
+        if (!hnet_protocol_reserve_ack(host, peer, sizeof(HNetProtocolSelectiveAck), pCmd)) {
+            return;
+        }
+
+        HNetChannel& channel = *reinterpret_cast<HNetChannel*>(HNetList::remove(peer.ackChannels.begin()));
+        hnet_protocol_init_selective_ack(*pCmd, static_cast<uint8_t>(&channel - peer.channels), channel.ackBaseSeqNumber, channel.ackSentTime, channel.ackBitmap);
+        channel.ackBitmap = 0;
     }
 }
 
-static bool hnet_protocol_send_reliable_outgoing_commands(HNetHost& host, HNetPeer& peer)
+static bool hnet_protocol_is_reliable_window_full(const HNetChannel& channel, const HNetOutgoingCommand& cmd)
 {
-    if (peer.outgoingReliableCommands.empty()) {
-        return true;
+    if (cmd.sendAttempts > 0 || (cmd.reliableSeqNumber % HNET_PEER_RELIABLE_WINDOW_SIZE) != 0) {
+        return false;
     }
 
+    uint16_t reliableWindow = cmd.reliableSeqNumber / HNET_PEER_RELIABLE_WINDOW_SIZE;
+    uint32_t freeWindows = (1u << (HNET_PEER_FREE_RELIABLE_WINDOWS + 2)) - 1;
+    return channel.reliableWindows[(reliableWindow + HNET_PEER_RELIABLE_WINDOWS - 1) % HNET_PEER_RELIABLE_WINDOWS] >= HNET_PEER_RELIABLE_WINDOW_SIZE ||
+           (channel.usedReliableWindows & ((freeWindows << reliableWindow) | (freeWindows >> (HNET_PEER_RELIABLE_WINDOWS - reliableWindow))));
+}
+
+static bool hnet_protocol_send_reliable_outgoing_commands(HNetHost& host, HNetPeer& peer)
+{
+    bool canPing = true;
+    bool windowWrap = false;
+    bool windowExceeded = false;
+    peer.reliableWindowStalled = false;
+
     for (HNetListNode* pNode = peer.outgoingReliableCommands.begin(); pNode != peer.outgoingReliableCommands.end();) {
         HNetOutgoingCommand* pCmd = reinterpret_cast<HNetOutgoingCommand*>(pNode);
 
+        HNetChannel* pChannel = pCmd->command.header.channelId < peer.channelCount ? &peer.channels[pCmd->command.header.channelId] : nullptr;
+        if (pChannel != nullptr) {
+            if (!windowWrap && hnet_protocol_is_reliable_window_full(*pChannel, *pCmd)) {
+                windowWrap = true;
+            }
+            if (windowWrap) {
+                pNode = pNode->next;
+                continue;
+            }
+        }
+
+        if (pCmd->packet != nullptr) {
+            if (!windowExceeded) {
+                uint32_t windowSize = (peer.packetThrottle * peer.windowSize) / HNET_PEER_PACKET_THROTTLE_SCALE;
+                if (peer.reliableDataInTransit + pCmd->fragmentLength > std::max(windowSize, peer.mtu)) {
+                    windowExceeded = true;
+                }
+            }
+            if (windowExceeded) {
+                pNode = pNode->next;
+                continue;
+            }
+        }
+
         size_t cmdSize = hnet_protocol_command_size(pCmd->command.header.command);
         uint32_t remainingSize = static_cast<uint32_t>(peer.mtu - host.packetSize);
         if ((host.commandCount >= HNET_PROTOCOL_MAX_PACKET_COMMANDS) ||
@@ -164,14 +252,22 @@ static bool hnet_protocol_send_reliable_outgoing_commands(HNetHost& host, HNetPe
             (remainingSize < cmdSize) ||
             ((pCmd->packet != nullptr) && (remainingSize < static_cast<uint32_t>(cmdSize + pCmd->fragmentLength)))) {
             host.continueSending = true;
-            break;
+            return false;
+        }
+
+        canPing = false;
+
+        if (pChannel != nullptr && pCmd->sendAttempts == 0) {
+            uint16_t reliableWindow = pCmd->reliableSeqNumber / HNET_PEER_RELIABLE_WINDOW_SIZE;
+            pChannel->usedReliableWindows |= 1 << reliableWindow;
+            ++pChannel->reliableWindows[reliableWindow];
         }
 
         ++pCmd->sendAttempts;
 
         if (pCmd->roundTripTimeout == 0) {
             pCmd->roundTripTimeout = peer.roundTripTime + 4 * peer.roundTripTimeVariance;
-            pCmd->roundTripTimeoutLimit = peer.timeoutLimit * pCmd->roundTripTimeoutLimit;
+            pCmd->roundTripTimeoutLimit = peer.timeoutLimit * pCmd->roundTripTimeout;
         }
 
         if (peer.sentReliableCommands.empty()) {
@@ -202,13 +298,39 @@ static bool hnet_protocol_send_reliable_outgoing_commands(HNetHost& host, HNetPe
         ++peer.packetsSent;
     }
 
-    return false;
+    // whatever is left waits for acks to open the window, not for more room in the datagram
+    peer.reliableWindowStalled = windowWrap || windowExceeded;
+    return canPing;
 }
 
 static void hnet_protocol_send_unreliable_outgoing_commands(HNetHost& host, HNetPeer& peer)
 {
-    for (HNetListNode* pNode = peer.outgoingUnreliableCommands.begin(); pNode != peer.outgoingUnreliableCommands.end(); pNode = pNode->next) {
+    for (HNetListNode* pNode = peer.outgoingUnreliableCommands.begin(); pNode != peer.outgoingUnreliableCommands.end();) {
         HNetOutgoingCommand* pCmd = reinterpret_cast<HNetOutgoingCommand*>(pNode);
+        if (pCmd->packet != nullptr && pCmd->fragmentOffset == 0) {
+            peer.packetThrottleCounter += HNET_PEER_PACKET_THROTTLE_COUNTER;
+            peer.packetThrottleCounter %= HNET_PEER_PACKET_THROTTLE_SCALE;
+            if (peer.packetThrottleCounter > peer.packetThrottle) {
+                // shed the whole message, every fragment shares its sequence numbers
+                uint16_t reliableSeqNumber = pCmd->reliableSeqNumber;
+                uint16_t unreliableSeqNumber = pCmd->unreliableSeqNumber;
+                do {
+                    pNode = pNode->next;
+                    HNetList::remove(&pCmd->outgoingCommandList);
+                    if (--pCmd->packet->refCount == 0) {
+                        hnet_packet_destroy(pCmd->packet);
+                    }
+                    hnet_pool_release(host.outgoingCommandPool, pCmd);
+                    pCmd = reinterpret_cast<HNetOutgoingCommand*>(pNode);
+                } while (pNode != peer.outgoingUnreliableCommands.end() &&
+                         pCmd->fragmentOffset != 0 &&
+                         pCmd->reliableSeqNumber == reliableSeqNumber &&
+                         pCmd->unreliableSeqNumber == unreliableSeqNumber);
+                ++peer.unreliablePacketsThrottled;
+                continue;
+            }
+        }
+
         size_t cmdSize = hnet_protocol_command_size(pCmd->command.header.command);
         uint32_t remainingSize = static_cast<uint32_t>(peer.mtu - host.packetSize);
         if ((host.commandCount >= HNET_PROTOCOL_MAX_PACKET_COMMANDS) ||
@@ -227,8 +349,13 @@ static void hnet_protocol_send_unreliable_outgoing_commands(HNetHost& host, HNet
         host.packetSize += buffer.dataLength;
         cmd = pCmd->command;
 
+        pNode = pNode->next;
         HNetList::remove(&pCmd->outgoingCommandList);
 
+        if (pCmd->packet != nullptr && pCmd->fragmentOffset == 0) {
+            ++peer.unreliablePacketsSent;
+        }
+
         if (pCmd->packet != nullptr) {
             HNetBuffer& buffer2 = host.buffers[host.bufferCount++];
             buffer2.data = pCmd->packet->data + pCmd->fragmentOffset;
@@ -236,7 +363,7 @@ static void hnet_protocol_send_unreliable_outgoing_commands(HNetHost& host, HNet
             host.packetSize += pCmd->fragmentLength;
             peer.sentUnreliableCommands.push_back(&pCmd->outgoingCommandList);
         } else {
-            hnet_free(pCmd);
+            hnet_pool_release(host.outgoingCommandPool, pCmd);
         }
     }
 
@@ -282,6 +409,17 @@ static HNetProtocolCommand hnet_protocol_remove_sent_reliable_command(HNetPeer&
         wasSent = false;
     }
 
+    if (channelId < peer.channelCount) {
+        HNetChannel& channel = peer.channels[channelId];
+        uint16_t reliableWindow = reliableSeqNumber / HNET_PEER_RELIABLE_WINDOW_SIZE;
+        if (channel.reliableWindows[reliableWindow] > 0) {
+            --channel.reliableWindows[reliableWindow];
+            if (channel.reliableWindows[reliableWindow] == 0) {
+                channel.usedReliableWindows &= ~(1 << reliableWindow);
+            }
+        }
+    }
+
     HNetProtocolCommand cmdNumber = static_cast<HNetProtocolCommand>(pOutgoingCmd->command.header.command & HNET_PROTOCOL_COMMAND_MASK);
     HNetList::remove(&pOutgoingCmd->outgoingCommandList);
 
@@ -296,7 +434,12 @@ static HNetProtocolCommand hnet_protocol_remove_sent_reliable_command(HNetPeer&
         }
     }
 
-    hnet_free(pOutgoingCmd);
+    hnet_pool_release(peer.host->outgoingCommandPool, pOutgoingCmd);
+
+    if (peer.reliableWindowStalled) {
+        peer.reliableWindowStalled = false;
+        hnet_peer_queue_send(peer);
+    }
 
     if (!peer.sentReliableCommands.empty()) {
         pOutgoingCmd = reinterpret_cast<HNetOutgoingCommand*>(peer.sentReliableCommands.front());
@@ -325,7 +468,7 @@ static void hnet_protocol_remove_sent_unreliable_commands(HNetPeer& peer)
             }
         }
 
-        hnet_free(pCmd);
+        hnet_pool_release(peer.host->outgoingCommandPool, pCmd);
     }
 
     if (peer.state == HNetPeerState::DisconnectLater &&
@@ -336,20 +479,16 @@ static void hnet_protocol_remove_sent_unreliable_commands(HNetPeer& peer)
     }
 }
 
-static bool hnet_protocol_handle_ack(HNetHost& host, HNetEvent& event, HNetPeer& peer, const HNetProtocol& cmd)
+static bool hnet_protocol_update_round_trip_time(HNetHost& host, HNetPeer& peer, uint16_t sentTime)
 {
-    if (peer.state == HNetPeerState::Disconnected || peer.state == HNetPeerState::Zombie) {
-        return true;
-    }
-
-    uint32_t recvSentTime = HNET_NET_TO_HOST_16(cmd.ack.recvSentTime);
+    uint32_t recvSentTime = sentTime;
     recvSentTime |= (host.serviceTime & 0xFFFF0000);
     if ((recvSentTime & 0x8000) > (host.serviceTime & 0x8000)) {
         recvSentTime -= 0x10000;
     }
 
     if (HNET_TIME_LT(host.serviceTime, recvSentTime)) {
-        return true;
+        return false;
     }
 
     peer.lastRecvTime = host.serviceTime;
@@ -381,6 +520,19 @@ static bool hnet_protocol_handle_ack(HNetHost& host, HNetEvent& event, HNetPeer&
         peer.packetThrottleEpoch = host.serviceTime;
     }
 
+    return true;
+}
+
+static bool hnet_protocol_handle_ack(HNetHost& host, HNetEvent& event, HNetPeer& peer, const HNetProtocol& cmd)
+{
+    if (peer.state == HNetPeerState::Disconnected || peer.state == HNetPeerState::Zombie) {
+        return true;
+    }
+
+    if (!hnet_protocol_update_round_trip_time(host, peer, HNET_NET_TO_HOST_16(cmd.ack.recvSentTime))) {
+        return true;
+    }
+
     uint16_t recvReliableSeqNumber = HNET_NET_TO_HOST_16(cmd.ack.recvReliableSeqNumber);
     HNetProtocolCommand cmdNumber = hnet_protocol_remove_sent_reliable_command(peer, recvReliableSeqNumber, cmd.header.channelId);
 
@@ -412,6 +564,36 @@ static bool hnet_protocol_handle_ack(HNetHost& host, HNetEvent& event, HNetPeer&
     return true;
 }
 
+static bool hnet_protocol_handle_selective_ack(HNetHost& host, HNetPeer& peer, const HNetProtocol& cmd)
+{
+    if (!peer.selectiveAcks || cmd.header.channelId >= peer.channelCount) {
+        return false;
+    }
+    if (peer.state == HNetPeerState::Disconnected || peer.state == HNetPeerState::Zombie) {
+        return true;
+    }
+
+    if (!hnet_protocol_update_round_trip_time(host, peer, HNET_NET_TO_HOST_16(cmd.selectiveAck.recvSentTime))) {
+        return true;
+    }
+
+    uint32_t ackBitmap = HNET_NET_TO_HOST_32(cmd.selectiveAck.ackBitmap);
+    while (ackBitmap != 0) {
+        uint16_t offset = static_cast<uint16_t>(__builtin_ctz(ackBitmap));
+        ackBitmap &= ackBitmap - 1;
+        hnet_protocol_remove_sent_reliable_command(peer, cmd.header.reliableSeqNumber + offset, cmd.header.channelId);
+    }
+
+    if (peer.state == HNetPeerState::DisconnectLater &&
+        peer.outgoingReliableCommands.empty() &&
+        peer.outgoingUnreliableCommands.empty() &&
+        peer.sentReliableCommands.empty()) {
+        hnet_peer_disconnect(peer, peer.eventData);
+    }
+
+    return true;
+}
+
 static bool hnet_protocol_handle_connect(HNetHost& host, HNetPeer*& pPeer, const HNetProtocol& cmd)
 {
     pPeer = nullptr;
@@ -420,22 +602,14 @@ static bool hnet_protocol_handle_connect(HNetHost& host, HNetPeer*& pPeer, const
         return false;
     }
 
-    size_t duplicatePeers = 0;
-    for (size_t i = 0; i < host.peerCount; i++) {
-        HNetPeer& peer = host.peers[i];
-        if (peer.state == HNetPeerState::Disconnected) {
-            if (pPeer == nullptr) {
-                pPeer = &peer;
-            }
-        } else if (peer.state != HNetPeerState::Connecting && peer.addr.host == host.recvAddr.host) {
-            if (peer.addr.port == host.recvAddr.port && peer.connectId == cmd.connect.connectId) {
-                return false;
-            }
-            ++duplicatePeers;
+    for (HNetPeer* pCurrent = hnet_host_find_peers(host, host.recvAddr); pCurrent != nullptr; pCurrent = pCurrent->bucketNext) {
+        HNetPeer& peer = *pCurrent;
+        if (peer.state != HNetPeerState::Connecting && !(peer.addr != host.recvAddr) && peer.connectId == cmd.connect.connectId) {
+            return false;
         }
     }
 
-    if (pPeer == nullptr || duplicatePeers >= host.duplicatePeers) {
+    if (host.freePeerCount == 0 || hnet_host_count_peers(host, host.recvAddr) >= host.duplicatePeers) {
         return false;
     }
 
@@ -447,12 +621,13 @@ static bool hnet_protocol_handle_connect(HNetHost& host, HNetPeer*& pPeer, const
     if (pChannels == nullptr) {
         return false;
     }
+    pPeer = hnet_host_acquire_peer(host);
     HNetPeer& peer = *pPeer;
     peer.channels = pChannels;
     peer.channelCount = channelCount;
     peer.state = HNetPeerState::AckConnect;
     peer.connectId = cmd.connect.connectId;
-    peer.addr = host.recvAddr;
+    hnet_host_set_peer_addr(host, peer, host.recvAddr);
     peer.outgoingPeerId = HNET_NET_TO_HOST_16(cmd.connect.outgoingPeerId);
     peer.incomingBandwidth = HNET_NET_TO_HOST_32(cmd.connect.incomingBandwidth);
     peer.outgoingBandwidth = HNET_NET_TO_HOST_32(cmd.connect.outgoingBandwidth);
@@ -460,6 +635,7 @@ static bool hnet_protocol_handle_connect(HNetHost& host, HNetPeer*& pPeer, const
     peer.packetThrottleAcceleration = HNET_NET_TO_HOST_32(cmd.connect.packetThrottleAcceleration);
     peer.packetThrottleDeceleration = HNET_NET_TO_HOST_32(cmd.connect.packetThrottleDeceleration);
     peer.eventData = HNET_NET_TO_HOST_32(cmd.connect.data);
+    peer.selectiveAcks = host.selectiveAcks && (HNET_NET_TO_HOST_32(cmd.connect.windowSize) & HNET_PROTOCOL_WINDOW_FLAG_SACK) != 0;
 
     uint8_t inSessionId = cmd.connect.incomingSessionId == 0xFF ? peer.outgoingSessionId : cmd.connect.incomingSessionId;
     inSessionId = (inSessionId + 1) & (HNET_PROTOCOL_HEADER_SESSION_MASK >> HNET_PROTOCOL_HEADER_SESSION_SHIFT);
@@ -485,6 +661,9 @@ static bool hnet_protocol_handle_connect(HNetHost& host, HNetPeer*& pPeer, const
         channel.incomingUnreliableCommands.clear();
         channel.usedReliableWindows = 0;
         memset(channel.reliableWindows, 0, sizeof(channel.reliableWindows));
+        channel.ackBaseSeqNumber = 0;
+        channel.ackSentTime = 0;
+        channel.ackBitmap = 0;
     }
 
     peer.mtu = std::clamp<uint32_t>(HNET_NET_TO_HOST_32(cmd.connect.mtu), HNET_PROTOCOL_MIN_MTU, HNET_PROTOCOL_MAX_MTU);
@@ -502,8 +681,8 @@ static bool hnet_protocol_handle_connect(HNetHost& host, HNetPeer*& pPeer, const
     if (host.incomingBandwidth > 0) {
         windowSize = host.incomingBandwidth / HNET_PEER_WINDOW_SIZE_SCALE * HNET_PROTOCOL_MIN_WINDOW_SIZE;
     }
-    if (windowSize > HNET_NET_TO_HOST_32(cmd.connect.windowSize)) {
-        windowSize = HNET_NET_TO_HOST_32(cmd.connect.windowSize);
+    if (windowSize > (HNET_NET_TO_HOST_32(cmd.connect.windowSize) & HNET_PROTOCOL_WINDOW_SIZE_MASK)) {
+        windowSize = HNET_NET_TO_HOST_32(cmd.connect.windowSize) & HNET_PROTOCOL_WINDOW_SIZE_MASK;
     }
     windowSize = std::clamp<uint32_t>(windowSize, HNET_PROTOCOL_MIN_WINDOW_SIZE, HNET_PROTOCOL_MAX_WINDOW_SIZE);
 
@@ -514,7 +693,7 @@ static bool hnet_protocol_handle_connect(HNetHost& host, HNetPeer*& pPeer, const
     verifyCmd.verifyConenct.incomingSessionId = inSessionId;
     verifyCmd.verifyConenct.outgoingSessionId = outSessionId;
     verifyCmd.verifyConenct.mtu = HNET_HOST_TO_NET_32(peer.mtu);
-    verifyCmd.verifyConenct.windowSize = HNET_HOST_TO_NET_32(windowSize);
+    verifyCmd.verifyConenct.windowSize = HNET_HOST_TO_NET_32(windowSize | (peer.selectiveAcks ? HNET_PROTOCOL_WINDOW_FLAG_SACK : 0));
     verifyCmd.verifyConenct.channelCount = HNET_HOST_TO_NET_32(channelCount);
     verifyCmd.verifyConenct.incomingBandwidth = HNET_HOST_TO_NET_32(host.incomingBandwidth);
     verifyCmd.verifyConenct.outgoingBandwidth = HNET_HOST_TO_NET_32(host.outgoingBandwidth);
@@ -559,7 +738,9 @@ static bool hnet_protocol_handle_verify_connect(HNetHost& host, HNetEvent& event
         peer.mtu = mtu;
     }
 
-    uint32_t windowSize = std::clamp<uint32_t>(HNET_NET_TO_HOST_32(cmd.verifyConenct.windowSize), HNET_PROTOCOL_MIN_WINDOW_SIZE, HNET_PROTOCOL_MAX_WINDOW_SIZE);
+    uint32_t windowSize = HNET_NET_TO_HOST_32(cmd.verifyConenct.windowSize);
+    peer.selectiveAcks = peer.selectiveAcks && (windowSize & HNET_PROTOCOL_WINDOW_FLAG_SACK) != 0;
+    windowSize = std::clamp<uint32_t>(windowSize & HNET_PROTOCOL_WINDOW_SIZE_MASK, HNET_PROTOCOL_MIN_WINDOW_SIZE, HNET_PROTOCOL_MAX_WINDOW_SIZE);
     if (windowSize < peer.windowSize) {
         peer.windowSize = windowSize;
     }
@@ -613,7 +794,7 @@ static bool hnet_protocol_handle_send_reliable(HNetHost& host, HNetPeer& peer, H
     }
 
     uint8_t* pPacketData = reinterpret_cast<uint8_t*>(&cmd) + sizeof(HNetProtocolSendReliable);
-    if (!hnet_peer_queue_incoming_command(peer, cmd, pPacketData, dataLength, HNET_PACKET_FLAG_RELIABLE, 0)) {
+    if (hnet_peer_queue_incoming_command(peer, cmd, pPacketData, dataLength, HNET_PACKET_FLAG_RELIABLE, 0) == nullptr) {
         return false;
     }
 
@@ -633,7 +814,7 @@ static bool hnet_protocol_handle_send_unreliable(HNetHost& host, HNetPeer& peer,
     }
 
     uint8_t* pPacketData = reinterpret_cast<uint8_t*>(&cmd) + sizeof(HNetProtocolSendUnreliable);
-    if (!hnet_peer_queue_incoming_command(peer, cmd, pPacketData, dataLength, 0, 0)) {
+    if (hnet_peer_queue_incoming_command(peer, cmd, pPacketData, dataLength, 0, 0) == nullptr) {
         return false;
     }
 
@@ -673,7 +854,7 @@ bool hnet_protocol_handle_send_unsequenced(HNetHost& host, HNetPeer& peer, HNetP
     }
 
     uint8_t* pPacketData = reinterpret_cast<uint8_t*>(&cmd) + sizeof(HNetProtocolSendUnsequenced);
-    if (!hnet_peer_queue_incoming_command(peer, cmd, pPacketData, dataLength, HNET_PACKET_FLAG_UNSEQUENCED, 0)) {
+    if (hnet_peer_queue_incoming_command(peer, cmd, pPacketData, dataLength, HNET_PACKET_FLAG_UNSEQUENCED, 0) == nullptr) {
         return false;
     }
 
@@ -721,18 +902,232 @@ bool hnet_protocol_handle_throttle_configure(HNetHost& host, HNetPeer& peer, con
     return true;
 }
 
+static HNetIncomingCommand* hnet_protocol_find_fragment_start_command(HNetChannel& channel, uint16_t startSeqNumber, uint32_t fragmentCount, uint32_t totalLength, bool& isValid)
+{
+    isValid = true;
+    for (HNetListNode* pNode = channel.incomingReliableCommands.back(); pNode != channel.incomingReliableCommands.end(); pNode = pNode->prev) {
+        HNetIncomingCommand* pCmd = reinterpret_cast<HNetIncomingCommand*>(pNode);
+        if (startSeqNumber >= channel.incomingReliableSeqNumber) {
+            if (pCmd->reliableSeqNumber < channel.incomingReliableSeqNumber) {
+                continue;
+            }
+        } else if (pCmd->reliableSeqNumber >= channel.incomingReliableSeqNumber) {
+            break;
+        }
+
+        if (pCmd->reliableSeqNumber <= startSeqNumber) {
+            if (pCmd->reliableSeqNumber < startSeqNumber) {
+                break;
+            }
+            if ((pCmd->command.header.command & HNET_PROTOCOL_COMMAND_MASK) != HNET_PROTOCOL_COMMAND_SEND_FRAGMENT ||
+                totalLength != pCmd->packet->dataLength ||
+                fragmentCount != pCmd->fragmentCount) {
+                isValid = false;
+                return nullptr;
+            }
+            return pCmd;
+        }
+    }
+    return nullptr;
+}
+
 bool hnet_protocol_handle_send_fragment(HNetHost& host, HNetPeer& peer, const HNetProtocol& cmd, uint8_t*& pData)
 {
-    // fragment is not supported.
-    return false;
+    if (pData == nullptr || cmd.header.channelId >= peer.channelCount || (peer.state != HNetPeerState::Connected && peer.state != HNetPeerState::DisconnectLater)) {
+        return false;
+    }
+
+    uint32_t fragmentLength = HNET_NET_TO_HOST_16(cmd.sendFragment.dataLength);
+    pData += fragmentLength;
+    if (fragmentLength == 0 || fragmentLength > host.maxPacketSize || pData < host.recvData || &host.recvData[host.recvDataLength] < pData) {
+        return false;
+    }
+
+    HNetChannel& channel = peer.channels[cmd.header.channelId];
+    uint16_t startSeqNumber = HNET_NET_TO_HOST_16(cmd.sendFragment.startSeqNumber);
+    uint16_t startWindow = startSeqNumber / HNET_PEER_RELIABLE_WINDOW_SIZE;
+    uint16_t currentWindow = channel.incomingReliableSeqNumber / HNET_PEER_RELIABLE_WINDOW_SIZE;
+    if (startSeqNumber < channel.incomingReliableSeqNumber) {
+        startWindow += HNET_PEER_RELIABLE_WINDOWS;
+    }
+    if (startWindow < currentWindow || startWindow >= currentWindow + HNET_PEER_FREE_RELIABLE_WINDOWS - 1) {
+        return true;
+    }
+
+    uint32_t fragmentNumber = HNET_NET_TO_HOST_32(cmd.sendFragment.fragmentNumber);
+    uint32_t fragmentCount = HNET_NET_TO_HOST_32(cmd.sendFragment.fragmentCount);
+    uint32_t fragmentOffset = HNET_NET_TO_HOST_32(cmd.sendFragment.fragmentOffset);
+    uint32_t totalLength = HNET_NET_TO_HOST_32(cmd.sendFragment.totalLength);
+    if (fragmentCount > HNET_PROTOCOL_MAX_FRAGMENT_COUNT ||
+        fragmentNumber >= fragmentCount ||
+        totalLength > host.maxPacketSize ||
+        totalLength < fragmentCount ||
+        fragmentOffset >= totalLength ||
+        fragmentLength > totalLength - fragmentOffset) {
+        return false;
+    }
+
+    bool isValid = true;
+    HNetIncomingCommand* pStartCmd = hnet_protocol_find_fragment_start_command(channel, startSeqNumber, fragmentCount, totalLength, isValid);
+    if (!isValid) {
+        return false;
+    }
+
+    if (pStartCmd == nullptr) {
+        HNetProtocol startCmd = cmd;
+        startCmd.header.reliableSeqNumber = startSeqNumber;
+        pStartCmd = hnet_peer_queue_incoming_command(peer, startCmd, nullptr, totalLength, HNET_PACKET_FLAG_RELIABLE, fragmentCount);
+        if (pStartCmd == nullptr) {
+            return false;
+        }
+    }
+
+    uint32_t fragmentBit = 1u << (fragmentNumber % 32);
+    if ((pStartCmd->fragments[fragmentNumber / 32] & fragmentBit) == 0) {
+        --pStartCmd->fragmentsRemaining;
+        pStartCmd->fragments[fragmentNumber / 32] |= fragmentBit;
+
+        const uint8_t* pFragmentData = reinterpret_cast<const uint8_t*>(&cmd) + sizeof(HNetProtocolSendFragment);
+        memcpy(pStartCmd->packet->data + fragmentOffset, pFragmentData, fragmentLength);
+
+        if (pStartCmd->fragmentsRemaining == 0) {
+            hnet_peer_dispatch_incoming_reliable_commands(peer, channel);
+        }
+    }
+
+    return true;
 }
 
-bool hnet_protocol_handle_send_unreliable_fragment(HNetHost& host, HNetPeer& peer, const HNetProtocol& cmd)
+static HNetIncomingCommand* hnet_protocol_find_unreliable_fragment_start_command(HNetChannel& channel, uint16_t reliableSeqNumber, uint16_t startSeqNumber, uint32_t fragmentCount, uint32_t totalLength, bool& isValid)
 {
-    // fragment is not supported.
+    isValid = true;
+    for (HNetListNode* pNode = channel.incomingUnreliableCommands.back(); pNode != channel.incomingUnreliableCommands.end(); pNode = pNode->prev) {
+        HNetIncomingCommand* pCmd = reinterpret_cast<HNetIncomingCommand*>(pNode);
+        if ((pCmd->command.header.command & HNET_PROTOCOL_COMMAND_MASK) == HNET_PROTOCOL_COMMAND_SEND_UNSEQUENCED) {
+            continue;
+        }
+        if (reliableSeqNumber >= channel.incomingReliableSeqNumber) {
+            if (pCmd->reliableSeqNumber < channel.incomingReliableSeqNumber) {
+                continue;
+            }
+        } else if (pCmd->reliableSeqNumber >= channel.incomingReliableSeqNumber) {
+            break;
+        }
+
+        if (pCmd->reliableSeqNumber < reliableSeqNumber) {
+            break;
+        }
+        if (pCmd->reliableSeqNumber > reliableSeqNumber) {
+            continue;
+        }
+
+        if (pCmd->unreliableSeqNumber <= startSeqNumber) {
+            if (pCmd->unreliableSeqNumber < startSeqNumber) {
+                break;
+            }
+            if ((pCmd->command.header.command & HNET_PROTOCOL_COMMAND_MASK) != HNET_PROTOCOL_COMMAND_SEND_UNRELIABLE_FRAGMENT ||
+                totalLength != pCmd->packet->dataLength ||
+                fragmentCount != pCmd->fragmentCount) {
+                isValid = false;
+                return nullptr;
+            }
+            return pCmd;
+        }
+    }
+    return nullptr;
+}
+
+static bool hnet_protocol_is_stale_unreliable_fragment(HNetChannel& channel, uint16_t reliableSeqNumber, uint16_t startSeqNumber)
+{
+    for (HNetListNode* pNode = channel.incomingUnreliableCommands.back(); pNode != channel.incomingUnreliableCommands.end(); pNode = pNode->prev) {
+        HNetIncomingCommand* pCmd = reinterpret_cast<HNetIncomingCommand*>(pNode);
+        if ((pCmd->command.header.command & HNET_PROTOCOL_COMMAND_MASK) == HNET_PROTOCOL_COMMAND_SEND_UNSEQUENCED) {
+            continue;
+        }
+        uint16_t newestOffset = pCmd->reliableSeqNumber - channel.incomingReliableSeqNumber;
+        uint16_t offset = reliableSeqNumber - channel.incomingReliableSeqNumber;
+        return newestOffset > offset || (newestOffset == offset && pCmd->unreliableSeqNumber > startSeqNumber);
+    }
     return false;
 }
 
+bool hnet_protocol_handle_send_unreliable_fragment(HNetHost& host, HNetPeer& peer, const HNetProtocol& cmd, uint8_t*& pData)
+{
+    if (pData == nullptr || cmd.header.channelId >= peer.channelCount || (peer.state != HNetPeerState::Connected && peer.state != HNetPeerState::DisconnectLater)) {
+        return false;
+    }
+
+    uint32_t fragmentLength = HNET_NET_TO_HOST_16(cmd.sendFragment.dataLength);
+    pData += fragmentLength;
+    if (fragmentLength == 0 || fragmentLength > host.maxPacketSize || pData < host.recvData || &host.recvData[host.recvDataLength] < pData) {
+        return false;
+    }
+
+    HNetChannel& channel = peer.channels[cmd.header.channelId];
+    uint16_t reliableSeqNumber = cmd.header.reliableSeqNumber;
+    uint16_t startSeqNumber = HNET_NET_TO_HOST_16(cmd.sendFragment.startSeqNumber);
+    uint16_t reliableWindow = reliableSeqNumber / HNET_PEER_RELIABLE_WINDOW_SIZE;
+    uint16_t currentWindow = channel.incomingReliableSeqNumber / HNET_PEER_RELIABLE_WINDOW_SIZE;
+    if (reliableSeqNumber < channel.incomingReliableSeqNumber) {
+        reliableWindow += HNET_PEER_RELIABLE_WINDOWS;
+    }
+    if (reliableWindow < currentWindow || reliableWindow >= currentWindow + HNET_PEER_FREE_RELIABLE_WINDOWS - 1) {
+        return true;
+    }
+    if (reliableSeqNumber == channel.incomingReliableSeqNumber && startSeqNumber <= channel.incomingUnreliableSeqNumber) {
+        return true;
+    }
+
+    uint32_t fragmentNumber = HNET_NET_TO_HOST_32(cmd.sendFragment.fragmentNumber);
+    uint32_t fragmentCount = HNET_NET_TO_HOST_32(cmd.sendFragment.fragmentCount);
+    uint32_t fragmentOffset = HNET_NET_TO_HOST_32(cmd.sendFragment.fragmentOffset);
+    uint32_t totalLength = HNET_NET_TO_HOST_32(cmd.sendFragment.totalLength);
+    if (fragmentCount > HNET_PROTOCOL_MAX_FRAGMENT_COUNT ||
+        fragmentNumber >= fragmentCount ||
+        totalLength > host.maxPacketSize ||
+        totalLength < fragmentCount ||
+        fragmentOffset >= totalLength ||
+        fragmentLength > totalLength - fragmentOffset) {
+        return false;
+    }
+
+    bool isValid = true;
+    HNetIncomingCommand* pStartCmd = hnet_protocol_find_unreliable_fragment_start_command(channel, reliableSeqNumber, startSeqNumber, fragmentCount, totalLength, isValid);
+    if (!isValid) {
+        return false;
+    }
+
+    if (pStartCmd == nullptr) {
+        if (hnet_protocol_is_stale_unreliable_fragment(channel, reliableSeqNumber, startSeqNumber)) {
+            return true;
+        }
+        hnet_peer_remove_unreliable_fragments(peer, channel);
+        if (peer.unreliableFragmentData + totalLength > host.maxUnreliableFragmentData) {
+            return true;
+        }
+        pStartCmd = hnet_peer_queue_incoming_command(peer, cmd, nullptr, totalLength, HNET_PACKET_FLAG_UNRELIABLE_FRAGMENT, fragmentCount);
+        if (pStartCmd == nullptr) {
+            return false;
+        }
+    }
+
+    uint32_t fragmentBit = 1u << (fragmentNumber % 32);
+    if ((pStartCmd->fragments[fragmentNumber / 32] & fragmentBit) == 0) {
+        --pStartCmd->fragmentsRemaining;
+        pStartCmd->fragments[fragmentNumber / 32] |= fragmentBit;
+
+        const uint8_t* pFragmentData = reinterpret_cast<const uint8_t*>(&cmd) + sizeof(HNetProtocolSendFragment);
+        memcpy(pStartCmd->packet->data + fragmentOffset, pFragmentData, fragmentLength);
+
+        if (pStartCmd->fragmentsRemaining == 0) {
+            peer.unreliableFragmentData -= pStartCmd->packet->dataLength;
+            hnet_peer_dispatch_incoming_unreliable_commands(peer, channel, nullptr);
+        }
+    }
+
+    return true;
+}
+
 static bool hnet_protocol_handle_command(HNetHost& host, HNetEvent& event, HNetPeer*& pPeer, HNetProtocol& cmd, uint8_t*& pData)
 {
     uint8_t cmdNumber = cmd.header.command & HNET_PROTOCOL_COMMAND_MASK;
@@ -771,17 +1166,44 @@ static bool hnet_protocol_handle_command(HNetHost& host, HNetEvent& event, HNetP
         return hnet_protocol_handle_throttle_configure(host, *pPeer, cmd);
 
     case HNET_PROTOCOL_COMMAND_SEND_UNRELIABLE_FRAGMENT:
-        return hnet_protocol_handle_send_unreliable_fragment(host, *pPeer, cmd);
+        return hnet_protocol_handle_send_unreliable_fragment(host, *pPeer, cmd, pData);
+
+    case HNET_PROTOCOL_COMMAND_SELECTIVE_ACKNOWLEDGE:
+        return hnet_protocol_handle_selective_ack(host, *pPeer, cmd);
 
     default:
         return false;
     }
 }
 
+static bool hnet_protocol_decompress(HNetHost& host, size_t headerSize)
+{
+    if (host.compressor.context == nullptr || host.compressor.decompress == nullptr) {
+        return false;
+    }
+
+    uint64_t startTime = hnet_time_now_usec();
+    uint8_t* pOut = host.packetData[1];
+    size_t originalSize = host.compressor.decompress(host.compressor.context,
+                                                     host.recvData + headerSize,
+                                                     host.recvDataLength - headerSize,
+                                                     pOut + headerSize,
+                                                     sizeof(host.packetData[1]) - headerSize);
+    host.decompressTime += hnet_time_now_usec() - startTime;
+    if (originalSize == 0 || originalSize > sizeof(host.packetData[1]) - headerSize) {
+        return false;
+    }
+
+    // the commands no longer live in the received packet, so nothing may be viewed into it
+    memcpy(pOut, host.recvData, headerSize);
+    host.recvData = pOut;
+    host.recvDataLength = headerSize + originalSize;
+    host.recvPacket = nullptr;
+    return true;
+}
+
 static int hnet_protocol_handle_incoming_commands(HNetHost& host, HNetEvent& event)
 {
-    // @TODO: compress
-    // @TODO: checksum
     if (host.recvDataLength < offsetof(HNetProtocolHeader, sentTime)) {
         return 0;
     }
@@ -793,26 +1215,50 @@ static int hnet_protocol_handle_incoming_commands(HNetHost& host, HNetEvent& eve
     peerId &= ~(HNET_PROTOCOL_HEADER_FLAG_MASK | HNET_PROTOCOL_HEADER_SESSION_MASK);
 
     size_t headerSize = (flags & HNET_PROTOCOL_HEADER_FLAG_SENT_TIME) ? sizeof(HNetProtocolHeader) : offsetof(HNetProtocolHeader, sentTime);
+    if (host.checksum != nullptr) {
+        headerSize += sizeof(uint32_t);
+    }
+    if (host.recvDataLength < headerSize) {
+        return 0;
+    }
 
     HNetPeer* pPeer = nullptr;
     if (peerId == HNET_PROTOCOL_MAX_PEER_ID) {
         pPeer = nullptr;
-    } else if (peerId >= host.peerCount) {
+    } else if (static_cast<size_t>(peerId >> host.shardBits) >= host.peerCount || (peerId & ((1u << host.shardBits) - 1)) != host.shardIndex) {
         return 0;
     } else if (peerId < HNET_PROTOCOL_MAX_PEER_ID) {
-        HNetPeer& peer = host.peers[peerId];
+        HNetPeer& peer = host.peers[peerId >> host.shardBits];
         if (peer.state == HNetPeerState::Disconnected ||
             peer.state == HNetPeerState::Zombie ||
-            ((host.recvAddr != peer.addr) && (peer.addr.host != HNET_HOST_BROADCAST)) ||
+            ((host.recvAddr != peer.addr) && !hnet_address_is_broadcast(peer.addr)) ||
             ((peer.outgoingPeerId < HNET_PROTOCOL_MAX_PEER_ID) && (sessionId != peer.incomingSessionId))) {
             return 0;
         }
         pPeer = &peer;
     }
 
+    if (flags & HNET_PROTOCOL_HEADER_FLAG_COMPRESSED) {
+        if (!hnet_protocol_decompress(host, headerSize)) {
+            return 0;
+        }
+        pHeader = reinterpret_cast<HNetProtocolHeader*>(host.recvData);
+    }
+
+    if (host.checksum != nullptr) {
+        // the sender summed with the connect id in the checksum slot, binding the datagram to this connection
+        uint32_t* pChecksum = reinterpret_cast<uint32_t*>(&host.recvData[headerSize - sizeof(uint32_t)]);
+        uint32_t desiredChecksum = *pChecksum;
+        *pChecksum = pPeer != nullptr ? pPeer->connectId : 0;
+
+        HNetBuffer buffer{host.recvData, host.recvDataLength};
+        if (host.checksum(&buffer, 1) != desiredChecksum) {
+            return 0;
+        }
+    }
+
     if (pPeer != nullptr) {
-        pPeer->addr.host = host.recvAddr.host;
-        pPeer->addr.port = host.recvAddr.port;
+        hnet_host_set_peer_addr(host, *pPeer, host.recvAddr);
         pPeer->incomingDataTotal += host.recvDataLength;
     }
 
@@ -873,6 +1319,9 @@ static int hnet_protocol_handle_incoming_commands(HNetHost& host, HNetEvent& eve
     }
 
 exit:
+    if (pPeer != nullptr) {
+        hnet_protocol_schedule_peer(host, *pPeer);
+    }
     return (event.type != HNetEventType::None) ? 1 : 0;
 }
 
@@ -914,10 +1363,10 @@ void hnet_protocol_init_connect_command(const HNetHost& host, const HNetPeer& pe
     cmd.connect.incomingSessionId = peer.incomingSessionId;
     cmd.connect.outgoingSessionId = peer.outgoingSessionId;
     cmd.connect.mtu = HNET_HOST_TO_NET_32(peer.mtu);
-    cmd.connect.windowSize = HNET_HOST_TO_NET_32(peer.windowSize);
+    cmd.connect.windowSize = HNET_HOST_TO_NET_32(peer.windowSize | (peer.selectiveAcks ? HNET_PROTOCOL_WINDOW_FLAG_SACK : 0));
     cmd.connect.channelCount = HNET_HOST_TO_NET_32(peer.channelCount);
     cmd.connect.incomingBandwidth = HNET_HOST_TO_NET_32(host.incomingBandwidth);
-    cmd.connect.outgoingSessionId = HNET_HOST_TO_NET_32(host.outgoingBandwidth);
+    cmd.connect.outgoingBandwidth = HNET_HOST_TO_NET_32(host.outgoingBandwidth);
     cmd.connect.packetThrottleInterval = HNET_HOST_TO_NET_32(peer.packetThrottleInterval);
     cmd.connect.packetThrottleAcceleration = HNET_HOST_TO_NET_32(peer.packetThrottleAcceleration);
     cmd.connect.packetThrottleDeceleration = HNET_HOST_TO_NET_32(peer.packetThrottleDeceleration);
@@ -938,6 +1387,7 @@ int32_t hnet_protocol_dispatch_incoming_commands(HNetHost& host, HNetEvent& even
             hnet_protocol_change_state(peer, HNetPeerState::Connected);
             event.type = HNetEventType::Connect;
             event.peer = &peer;
+            event.connectId = peer.connectId;
             event.data = peer.eventData;
             return 1;
 
@@ -945,6 +1395,7 @@ int32_t hnet_protocol_dispatch_incoming_commands(HNetHost& host, HNetEvent& even
             host.recalculateBandwidthLimits = true;
             event.type = HNetEventType::Disconnect;
             event.peer = &peer;
+            event.connectId = peer.connectId;
             event.data = peer.eventData;
             hnet_peer_reset(peer);
             return 1;
@@ -959,6 +1410,7 @@ int32_t hnet_protocol_dispatch_incoming_commands(HNetHost& host, HNetEvent& even
             }
             event.type = HNetEventType::Receive;
             event.peer = &peer;
+            event.connectId = peer.connectId;
             if (!peer.dispatchedCommands.empty()) {
                 peer.needsDispatch = true;
                 host.dispatchQueue.push_back(&peer.dispatchList);
@@ -973,91 +1425,299 @@ int32_t hnet_protocol_dispatch_incoming_commands(HNetHost& host, HNetEvent& even
     return 0;
 }
 
+static int32_t hnet_protocol_flush_send_buffers(HNetHost& host)
+{
+    HNetSocketMessage messages[HNET_SOCKET_MAX_BATCH_SIZE];
+    size_t messageCount = host.sendBatchCount;
+    for (size_t i = 0; i < messageCount; i++) {
+        HNetSendBuffer& sendBuffer = host.sendBuffers[i];
+        messages[i].addr = sendBuffer.peer->addr;
+        messages[i].buffers = sendBuffer.buffers;
+        messages[i].bufferCount = sendBuffer.bufferCount;
+        messages[i].sentLength = 0;
+    }
+
+    int32_t result = 0;
+    size_t sentCount = 0;
+    while (sentCount < messageCount) {
+        int32_t count = hnet_socket_send_batch(host.socket, messages + sentCount, messageCount - sentCount);
+        if (count < 0) {
+            result = -1;
+            break;
+        }
+        if (count == 0) {
+            // socket buffer is full, the rest is dropped like a lost datagram
+            break;
+        }
+        for (int32_t j = 0; j < count; j++) {
+            host.totalSentData += messages[sentCount + j].sentLength;
+        }
+        host.totalSentPackets += count;
+        host.totalSendBatches++;
+        host.totalSendBatchPackets += count;
+        sentCount += count;
+    }
+
+    for (size_t i = 0; i < messageCount; i++) {
+        hnet_protocol_remove_sent_unreliable_commands(*host.sendBuffers[i].peer);
+    }
+
+    host.sendBatchCount = 0;
+    host.commands = host.sendBuffers[0].commands;
+    host.buffers = host.sendBuffers[0].buffers;
+
+    return result;
+}
+
+// compresses everything after the header into the send buffer's own packetData, which has to
+// outlive the call because the datagram is only handed to the socket when the batch is flushed
+static size_t hnet_protocol_compress(HNetHost& host, HNetSendBuffer& sendBuffer)
+{
+    size_t originalSize = host.packetSize - sizeof(HNetProtocolHeader) - (host.checksum != nullptr ? sizeof(uint32_t) : 0);
+    uint64_t startTime = hnet_time_now_usec();
+    size_t compressedSize = host.compressor.compress(host.compressor.context,
+                                                     &host.buffers[1],
+                                                     host.bufferCount - 1,
+                                                     originalSize,
+                                                     sendBuffer.packetData,
+                                                     std::min(originalSize, sizeof(sendBuffer.packetData)));
+    host.compressTime += hnet_time_now_usec() - startTime;
+    host.totalCompressInput += originalSize;
+
+    if (compressedSize == 0 || compressedSize >= originalSize) {
+        host.totalCompressOutput += originalSize;
+        return 0;
+    }
+
+    host.totalCompressOutput += compressedSize;
+    host.headerFlags |= HNET_PROTOCOL_HEADER_FLAG_COMPRESSED;
+    return compressedSize;
+}
+
+static int32_t hnet_protocol_send_peer_commands(HNetHost& host, HNetPeer& peer, HNetEvent* pEvent, bool checkForTimeouts)
+{
+    HNetSendBuffer& sendBuffer = host.sendBuffers[host.sendBatchCount];
+    host.headerFlags = 0;
+    host.commands = sendBuffer.commands;
+    host.commandCount = 0;
+    host.buffers = sendBuffer.buffers;
+    host.bufferCount = 1;
+    host.packetSize = sizeof(HNetProtocolHeader) + (host.checksum != nullptr ? sizeof(uint32_t) : 0);
+
+    hnet_protocol_send_acks(host, peer);
+
+    if (checkForTimeouts && HNET_TIME_GE(host.serviceTime, peer.nextTimeout)) {
+        if (hnet_protocol_check_timeouts(host, peer, pEvent)) {
+            if (pEvent != nullptr && pEvent->type != HNetEventType::None) {
+                return 1;
+            }
+            return 0;
+        }
+    }
+
+    bool canPing = hnet_protocol_send_reliable_outgoing_commands(host, peer);
+    if (canPing && hnet_protocol_can_ping(host, peer)) {
+        hnet_peer_ping(peer);
+        hnet_protocol_send_reliable_outgoing_commands(host, peer);
+    }
+
+    hnet_protocol_send_unreliable_outgoing_commands(host, peer);
+
+    if (host.commandCount == 0) {
+        return 0;
+    }
+
+    hnet_peer_update_packet_loss(peer, host.serviceTime);
+
+    size_t compressedSize = 0;
+    if (host.compressor.context != nullptr && host.compressor.compress != nullptr) {
+        compressedSize = hnet_protocol_compress(host, sendBuffer);
+    }
+
+    HNetProtocolHeader* pHeader = reinterpret_cast<HNetProtocolHeader*>(sendBuffer.headerData);
+    hnet_protocol_make_protocol_header(host, peer, pHeader);
+
+    if (host.checksum != nullptr) {
+        // summed over the uncompressed commands, so the receiver verifies after decompressing
+        uint32_t* pChecksum = reinterpret_cast<uint32_t*>(&sendBuffer.headerData[host.buffers[0].dataLength]);
+        *pChecksum = peer.outgoingPeerId < HNET_PROTOCOL_MAX_PEER_ID ? peer.connectId : 0;
+        host.buffers[0].dataLength += sizeof(uint32_t);
+        *pChecksum = host.checksum(host.buffers, host.bufferCount);
+    }
+
+    if (compressedSize > 0) {
+        host.buffers[1].data = sendBuffer.packetData;
+        host.buffers[1].dataLength = compressedSize;
+        host.bufferCount = 2;
+    }
+
+    sendBuffer.bufferCount = host.bufferCount;
+    sendBuffer.peer = &peer;
+    if (++host.sendBatchCount >= host.sendBatchSize) {
+        return hnet_protocol_flush_send_buffers(host);
+    }
+
+    return 0;
+}
+
+static bool hnet_protocol_has_pending_output(const HNetPeer& peer)
+{
+    return !peer.acks.empty() ||
+           !peer.ackChannels.empty() ||
+           (!peer.outgoingReliableCommands.empty() && !peer.reliableWindowStalled) ||
+           !peer.outgoingUnreliableCommands.empty();
+}
+
+// queues what other threads handed over with hnet_peer_send_async, so it goes out in this same pass
+static void hnet_protocol_drain_async_sends(HNetHost& host)
+{
+    HNetAsyncSend send;
+    while (hnet_mpsc_ring_pop(host.asyncSends, send)) {
+        HNetPeer& peer = host.peers[send.peerId >> host.shardBits];
+        if ((peer.connectId != send.connectId || !hnet_peer_send(peer, send.channelId, *send.packet)) && send.packet->refCount == 0) {
+            hnet_packet_destroy(send.packet);
+        }
+    }
+}
+
 int32_t hnet_protocol_send_outgoing_commands(HNetHost& host, HNetEvent* pEvent, bool checkForTimeouts)
 {
-    // @TODO: checksum
-    // @TODO: compress
+    hnet_protocol_drain_async_sends(host);
+
+    if (checkForTimeouts) {
+        while (host.peerTimerCount > 0 && HNET_TIME_GE(host.serviceTime, host.peerTimers[0]->timerDeadline)) {
+            HNetPeer& peer = *host.peerTimers[0];
+            hnet_host_unschedule_peer(host, peer);
+            hnet_peer_queue_send(peer);
+        }
+    }
+
     host.continueSending = true;
 
     while (host.continueSending) {
         host.continueSending = false;
-        for (size_t i = 0; i < host.peerCount; i++) {
-            HNetPeer& peer = host.peers[i];
+
+        HNetList sendQueue;
+        if (!host.sendQueue.empty()) {
+            sendQueue.push_back(host.sendQueue.front(), host.sendQueue.back());
+        }
+
+        while (!sendQueue.empty()) {
+            HNetPeer& peer = *hnet_peer_from_send_list(HNetList::remove(sendQueue.front()));
+            peer.needsSend = false;
             if (peer.state == HNetPeerState::Disconnected || peer.state == HNetPeerState::Zombie)  {
                 continue;
             }
 
-            host.headerFlags = 0;
-            host.commandCount = 0;
-            host.bufferCount = 1;
-            host.packetSize = sizeof(HNetProtocolHeader);
-
-            hnet_protocol_send_acks(host, peer);
-
-            if (checkForTimeouts && HNET_TIME_GE(host.serviceTime, peer.nextTimeout)) {
-                if (hnet_protocol_check_timeouts(host, peer, pEvent)) {
-                    if (pEvent != nullptr && pEvent->type != HNetEventType::None) {
-                        return 1;
-                    }
-                    continue;
+            int32_t ret = hnet_protocol_send_peer_commands(host, peer, pEvent, checkForTimeouts);
+            hnet_protocol_schedule_peer(host, peer);
+            if (hnet_protocol_has_pending_output(peer)) {
+                hnet_peer_queue_send(peer);
+            }
+            if (ret != 0) {
+                // hand the unvisited peers back for the next call
+                if (!sendQueue.empty()) {
+                    host.sendQueue.push_back(sendQueue.front(), sendQueue.back());
+                }
+                if (ret > 0) {
+                    return hnet_protocol_flush_send_buffers(host) < 0 ? -1 : 1;
                 }
+                return -1;
             }
+        }
 
-            bool canPing = hnet_protocol_send_reliable_outgoing_commands(host, peer);
-            if (canPing && hnet_protocol_can_ping(host, peer)) {
-                hnet_peer_ping(peer);
-                hnet_protocol_send_reliable_outgoing_commands(host, peer);
-            }
+        if (host.sendBatchCount > 0 && hnet_protocol_flush_send_buffers(host) < 0) {
+            return -1;
+        }
+    }
 
-            hnet_protocol_send_unreliable_outgoing_commands(host, peer);
+    return 0;
+}
 
-            if (host.commandCount == 0) {
-                continue;
+static int32_t hnet_protocol_recv_batch(HNetHost& host)
+{
+    HNetAddr addrs[HNET_SOCKET_MAX_BATCH_SIZE];
+    HNetBuffer buffers[HNET_SOCKET_MAX_BATCH_SIZE];
+    size_t recvLengths[HNET_SOCKET_MAX_BATCH_SIZE];
+
+    for (size_t i = 0; i < host.recvBatchSize; i++) {
+        HNetRecvBuffer& recvBuffer = host.recvBuffers[i];
+        // views are only made on this thread, so a count of 1 cannot grow under us; anything else may be
+        // dropping on other threads, so hand our reference over in one step and reuse the buffer only if it was the last
+        if (recvBuffer.packet != nullptr && recvBuffer.packet->refCount.load(std::memory_order_acquire) != 1) {
+            if (--recvBuffer.packet->refCount == 0) {
+                recvBuffer.packet->refCount = 1;
+            } else {
+                recvBuffer.packet = nullptr;
             }
-
-            hnet_peer_update_packet_loss(peer, host.serviceTime);
-
-            uint8_t headerData[sizeof(HNetProtocolHeader) + sizeof(uint32_t)];
-            HNetProtocolHeader* pHeader = reinterpret_cast<HNetProtocolHeader*>(headerData);
-            hnet_protocol_make_protocol_header(host, peer, pHeader);
-
-            int32_t sentLength = hnet_socket_send(host.socket, peer.addr, host.buffers, host.bufferCount);
-            hnet_protocol_remove_sent_unreliable_commands(peer);
-
-            if (sentLength < 0) {
+        }
+        if (recvBuffer.packet == nullptr) {
+            recvBuffer.packet = hnet_packet_create(nullptr, HNET_PROTOCOL_MAX_MTU, 0);
+            if (recvBuffer.packet == nullptr) {
                 return -1;
             }
-
-            host.totalSentData += sentLength;
-            host.totalSentPackets++;
+            recvBuffer.packet->refCount = 1;
         }
+        buffers[i].data = recvBuffer.packet->data;
+        buffers[i].dataLength = HNET_PROTOCOL_MAX_MTU;
     }
 
-    return 0;
+    int32_t recvCount = hnet_socket_recv_batch(host.socket, addrs, buffers, recvLengths, host.recvBatchSize);
+    if (recvCount <= 0) {
+        return recvCount;
+    }
+
+    for (int32_t i = 0; i < recvCount; i++) {
+        host.recvBuffers[i].addr = addrs[i];
+        host.recvBuffers[i].dataLength = recvLengths[i];
+    }
+
+    host.recvBatchCount = recvCount;
+    host.recvBatchIndex = 0;
+    host.totalRecvBatches++;
+    host.totalRecvBatchPackets += recvCount;
+    return recvCount;
 }
 
 int32_t hnet_protocol_recv_incoming_commands(HNetHost& host, HNetEvent& event)
 {
     for (uint32_t i = 0; i < 256; i++) {
-        HNetBuffer buffer{};
-        buffer.data = host.packetData[0];
-        buffer.dataLength = sizeof(host.packetData[0]);
-
-        int32_t recvLength = hnet_socket_recv(host.socket, host.recvAddr, &buffer, 1);
-        if (recvLength <= 0) {
-            return recvLength;
+        if (host.recvBatchIndex >= host.recvBatchCount) {
+            int32_t recvCount = hnet_protocol_recv_batch(host);
+            if (recvCount <= 0) {
+                return recvCount;
+            }
         }
 
-        host.recvData = host.packetData[0];
-        host.recvDataLength = recvLength;
-        host.totalRecvData += recvLength;
+        HNetRecvBuffer& buffer = host.recvBuffers[host.recvBatchIndex++];
+        host.recvAddr = buffer.addr;
+        host.recvData = buffer.packet->data;
+        host.recvDataLength = buffer.dataLength;
+        host.totalRecvData += buffer.dataLength;
         host.totalRecvPackets++;
 
+        if (host.intercept != nullptr) {
+            // consumed datagrams leave the recv buffer untouched, so it is reused by the next batch
+            switch (host.intercept(&host, &event)) {
+            case 1:
+                if (event.type != HNetEventType::None) {
+                    return 1;
+                }
+                continue;
+            case -1:
+                return -1;
+            default:
+                break;
+            }
+        }
+
+        host.recvPacket = buffer.packet;
         int32_t ret = hnet_protocol_handle_incoming_commands(host, event);
+        host.recvPacket = nullptr;
         if (ret != 0) {
             return ret;
         }
     }
 
-    return -1;
+    return 0;
 }
@@ -36,10 +36,10 @@ void HNetServer::destroy(HNetServer*& pServer)
     }
 }
 
-void HNetServer::update()
+void HNetServer::update(uint32_t timeout)
 {
     HNetEvent event;
-    int32_t ret = hnet_host_service(m_Host, event);
+    int32_t ret = hnet_host_service(m_Host, event, timeout);
     if (ret > 0) {
         switch (event.type) {
         case HNetEventType::Connect:
@@ -1,18 +1,63 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <netdb.h>
+#include <netinet/in.h>
 #include <netinet/tcp.h>
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <sys/time.h>
 #include <poll.h>
 #include <unistd.h>
+#if defined(__linux__)
+#include <linux/filter.h>
+#include <sys/eventfd.h>
+#endif
 #include "socket.h"
 
 #ifndef MSG_NOSIGNAL
 #define MSG_NOSIGNAL 0
 #endif
 
+union HNetSockAddr
+{
+    sockaddr sa;
+    sockaddr_in sin;
+    sockaddr_in6 sin6;
+};
+
+// every socket is dual-stack AF_INET6 unless the kernel lacks IPv6, then they all fall back to AF_INET
+static sa_family_t s_socketFamily = AF_INET6;
+
+static socklen_t hnet_address_to_sockaddr(const HNetAddr& addr, HNetSockAddr& sockAddr)
+{
+    if (s_socketFamily == AF_INET6) {
+        sockAddr.sin6 = {};
+        sockAddr.sin6.sin6_family = AF_INET6;
+        sockAddr.sin6.sin6_port = HNET_HOST_TO_NET_16(addr.port);
+        sockAddr.sin6.sin6_scope_id = addr.scopeId;
+        memcpy(&sockAddr.sin6.sin6_addr, addr.host, sizeof(addr.host));
+        return sizeof(sockaddr_in6);
+    }
+
+    sockAddr.sin = {};
+    sockAddr.sin.sin_family = AF_INET;
+    sockAddr.sin.sin_port = HNET_HOST_TO_NET_16(addr.port);
+    sockAddr.sin.sin_addr.s_addr = hnet_address_is_ipv4(addr) ? hnet_address_get_ipv4(addr) : HNET_HOST_ANY;
+    return sizeof(sockaddr_in);
+}
+
+static void hnet_address_from_sockaddr(const HNetSockAddr& sockAddr, HNetAddr& addr)
+{
+    if (sockAddr.sa.sa_family == AF_INET6) {
+        memcpy(addr.host, &sockAddr.sin6.sin6_addr, sizeof(addr.host));
+        addr.scopeId = sockAddr.sin6.sin6_scope_id;
+        addr.port = HNET_NET_TO_HOST_16(sockAddr.sin6.sin6_port);
+    } else {
+        hnet_address_set_ipv4(addr, sockAddr.sin.sin_addr.s_addr);
+        addr.port = HNET_NET_TO_HOST_16(sockAddr.sin.sin_port);
+    }
+}
+
 bool hnet_address_set_host(HNetAddr& addr, const char* pHostName)
 {
     addrinfo* pResultList = nullptr;
@@ -21,12 +66,20 @@ bool hnet_address_set_host(HNetAddr& addr, const char* pHostName)
         return false;
     }
 
-    for (addrinfo* pResult = pResultList; pResult != nullptr; pResult = pResult->ai_next) {
-        if (pResult->ai_family == AF_INET && pResult->ai_addr != nullptr && pResult->ai_addrlen >= sizeof(sockaddr_in)) {
-            sockaddr_in* pSin = reinterpret_cast<sockaddr_in*>(pResult->ai_addr);
-            addr.host = pSin->sin_addr.s_addr;
-            freeaddrinfo(pResultList);
-            return true;
+    // IPv4 results win so names keep resolving as they did before dual-stack; IPv6-only names still work
+    static const int families[] = {AF_INET, AF_INET6};
+    for (int family : families) {
+        for (addrinfo* pResult = pResultList; pResult != nullptr; pResult = pResult->ai_next) {
+            if (pResult->ai_family == family && pResult->ai_addr != nullptr &&
+                pResult->ai_addrlen >= (family == AF_INET ? sizeof(sockaddr_in) : sizeof(sockaddr_in6))) {
+                HNetSockAddr sockAddr{};
+                memcpy(&sockAddr, pResult->ai_addr, pResult->ai_addrlen);
+                uint16_t port = addr.port;
+                hnet_address_from_sockaddr(sockAddr, addr);
+                addr.port = port;
+                freeaddrinfo(pResultList);
+                return true;
+            }
         }
     }
 
@@ -39,21 +92,41 @@ bool hnet_address_set_host(HNetAddr& addr, const char* pHostName)
 
 bool hnet_address_set_host_ip(HNetAddr& addr, const char* pHostName)
 {
-    return inet_pton(AF_INET, pHostName, &addr.host) == 1;
+    uint32_t host;
+    if (inet_pton(AF_INET, pHostName, &host) == 1) {
+        hnet_address_set_ipv4(addr, host);
+        return true;
+    }
+    if (inet_pton(AF_INET6, pHostName, addr.host) == 1) {
+        addr.scopeId = 0;
+        return true;
+    }
+    return false;
 }
 
 HNetSocket hnet_socket_create(HNetSocketType type)
 {
-    return socket(PF_INET, type == HNetSocketType::DataGram ? SOCK_DGRAM : SOCK_STREAM, 0);
+    int sockType = type == HNetSocketType::DataGram ? SOCK_DGRAM : SOCK_STREAM;
+    if (s_socketFamily == AF_INET6) {
+        HNetSocket sock = socket(PF_INET6, sockType, 0);
+        if (sock != HNET_SOCKET_NULL) {
+            int32_t v6Only = 0;
+            setsockopt(sock, IPPROTO_IPV6, IPV6_V6ONLY, reinterpret_cast<char*>(&v6Only), sizeof(int32_t));
+            return sock;
+        }
+        if (errno != EAFNOSUPPORT) {
+            return HNET_SOCKET_NULL;
+        }
+        s_socketFamily = AF_INET;
+    }
+    return socket(PF_INET, sockType, 0);
 }
 
 bool hnet_socket_bind(HNetSocket socket, HNetAddr& addr)
 {
-    sockaddr_in sin{};
-    sin.sin_family = AF_INET;
-    sin.sin_port = HNET_HOST_TO_NET_16(addr.port);
-    sin.sin_addr.s_addr = addr.host;
-    return bind(socket, reinterpret_cast<sockaddr*>(&sin), sizeof(sockaddr_in)) == 0;
+    HNetSockAddr sockAddr;
+    socklen_t sockAddrLength = hnet_address_to_sockaddr(addr, sockAddr);
+    return bind(socket, &sockAddr.sa, sockAddrLength) == 0;
 }
 
 void hnet_socket_destroy(HNetSocket socket)
@@ -77,6 +150,11 @@ bool hnet_socket_set_option(HNetSocket socket, HNetSocketOption option, int32_t
     case HNetSocketOption::REUSEADDR:
         result = setsockopt(socket, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<char*>(&val), sizeof(int32_t));
         break;
+    case HNetSocketOption::REUSEPORT:
+#if defined(SO_REUSEPORT)
+        result = setsockopt(socket, SOL_SOCKET, SO_REUSEPORT, reinterpret_cast<char*>(&val), sizeof(int32_t));
+#endif
+        break;
     case HNetSocketOption::RCVBUF:
         result = setsockopt(socket, SOL_SOCKET, SO_RCVBUF, reinterpret_cast<char*>(&val), sizeof(int32_t));
         break;
@@ -111,21 +189,21 @@ bool hnet_socket_set_option(HNetSocket socket, HNetSocketOption option, int32_t
 
 bool hnet_socket_get_addr(HNetSocket socket, HNetAddr& addr)
 {
-    sockaddr_in sin{};
-    socklen_t sinLength = sizeof(sockaddr_in);
+    HNetSockAddr sockAddr{};
+    socklen_t sockAddrLength = sizeof(sockAddr);
 
-    if (getsockname(socket, reinterpret_cast<sockaddr*>(&sin), &sinLength) == -1) {
+    if (getsockname(socket, &sockAddr.sa, &sockAddrLength) == -1) {
         return false;
     }
 
-    addr.host = static_cast<uint32_t>(sin.sin_addr.s_addr);
-    addr.port = HNET_NET_TO_HOST_16(sin.sin_port);
+    hnet_address_from_sockaddr(sockAddr, addr);
     return true;
 }
 
-bool hnet_socket_wait(HNetSocket socket, uint32_t& cond, uint32_t timeout)
+bool hnet_socket_wait(HNetSocket socket, uint32_t& cond, uint32_t timeout, HNetSocket wakeup)
 {
-    pollfd pollSocket{socket, 0, 0};
+    pollfd pollSockets[2] = {{socket, 0, 0}, {wakeup, POLLIN, 0}};
+    pollfd& pollSocket = pollSockets[0];
 
     if (cond & HNET_SOCKET_WAIT_SEND) {
         pollSocket.events |= POLLOUT;
@@ -134,7 +212,7 @@ bool hnet_socket_wait(HNetSocket socket, uint32_t& cond, uint32_t timeout)
         pollSocket.events |= POLLIN;
     }
 
-    int32_t pollCount = poll(&pollSocket, 1, timeout);
+    int32_t pollCount = poll(pollSockets, wakeup != HNET_SOCKET_NULL ? 2 : 1, timeout);
     if (pollCount < 0) {
         if (errno == EINTR && (cond & HNET_SOCKET_WAIT_INTR)) {
             cond = HNET_SOCKET_WAIT_INTR;
@@ -151,21 +229,61 @@ bool hnet_socket_wait(HNetSocket socket, uint32_t& cond, uint32_t timeout)
         if (pollSocket.revents & POLLIN) {
             cond |= HNET_SOCKET_WAIT_RECV;
         }
+        if (pollSockets[1].revents & POLLIN) {
+            uint64_t count;
+            read(wakeup, &count, sizeof(count));
+            cond |= HNET_SOCKET_WAIT_WAKEUP;
+        }
     }
 
     return true;
 }
 
+HNetSocket hnet_socket_create_wakeup()
+{
+#if defined(__linux__)
+    return eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+#else
+    return HNET_SOCKET_NULL;
+#endif
+}
+
+void hnet_socket_signal_wakeup(HNetSocket wakeup)
+{
+    // only fails once the counter would overflow, when a wakeup is pending anyway
+    uint64_t count = 1;
+    write(wakeup, &count, sizeof(count));
+}
+
+bool hnet_socket_set_reuseport_steering(HNetSocket socket, uint16_t idMask, uint16_t unassignedId, uint16_t shardMask)
+{
+#if defined(__linux__) && defined(SO_ATTACH_REUSEPORT_CBPF)
+    // the kernel runs this on the UDP payload; an index past the group size makes it fall back to its hash
+    sock_filter code[] = {
+        BPF_STMT(BPF_LD | BPF_W | BPF_LEN, 0),
+        BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, sizeof(uint16_t), 1, 0),
+        BPF_STMT(BPF_RET | BPF_K, 0xFFFFFFFF),
+        BPF_STMT(BPF_LD | BPF_H | BPF_ABS, 0),
+        BPF_STMT(BPF_ALU | BPF_AND | BPF_K, idMask),
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, unassignedId, 0, 1),
+        BPF_STMT(BPF_RET | BPF_K, 0xFFFFFFFF),
+        BPF_STMT(BPF_ALU | BPF_AND | BPF_K, shardMask),
+        BPF_STMT(BPF_RET | BPF_A, 0),
+    };
+    sock_fprog program{static_cast<unsigned short>(sizeof(code) / sizeof(code[0])), code};
+    return setsockopt(socket, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &program, sizeof(program)) == 0;
+#else
+    return false;
+#endif
+}
+
 int32_t hnet_socket_send(HNetSocket socket, HNetAddr& addr, HNetBuffer* pBuffers, size_t bufferCount)
 {
     msghdr msgHdr{};
-    sockaddr_in sin{};
+    HNetSockAddr sockAddr;
 
-    sin.sin_family = AF_INET;
-    sin.sin_port = HNET_HOST_TO_NET_16(addr.port);
-    sin.sin_addr.s_addr = addr.host;
-    msgHdr.msg_name = &sin;
-    msgHdr.msg_namelen = sizeof(sockaddr_in);
+    msgHdr.msg_name = &sockAddr;
+    msgHdr.msg_namelen = hnet_address_to_sockaddr(addr, sockAddr);
     msgHdr.msg_iov = reinterpret_cast<iovec*>(pBuffers);
     msgHdr.msg_iovlen = bufferCount;
 
@@ -180,13 +298,63 @@ int32_t hnet_socket_send(HNetSocket socket, HNetAddr& addr, HNetBuffer* pBuffers
     return sentLength;
 }
 
+int32_t hnet_socket_send_batch(HNetSocket socket, HNetSocketMessage* pMessages, size_t count)
+{
+    if (count > HNET_SOCKET_MAX_BATCH_SIZE) {
+        count = HNET_SOCKET_MAX_BATCH_SIZE;
+    }
+
+#if defined(__linux__)
+    mmsghdr msgHdrs[HNET_SOCKET_MAX_BATCH_SIZE];
+    HNetSockAddr sockAddrs[HNET_SOCKET_MAX_BATCH_SIZE];
+
+    for (size_t i = 0; i < count; i++) {
+        msghdr& msgHdr = msgHdrs[i].msg_hdr;
+        msgHdr = {};
+        msgHdr.msg_name = &sockAddrs[i];
+        msgHdr.msg_namelen = hnet_address_to_sockaddr(pMessages[i].addr, sockAddrs[i]);
+        msgHdr.msg_iov = reinterpret_cast<iovec*>(pMessages[i].buffers);
+        msgHdr.msg_iovlen = pMessages[i].bufferCount;
+        msgHdrs[i].msg_len = 0;
+    }
+
+    int32_t sentCount = sendmmsg(socket, msgHdrs, count, MSG_NOSIGNAL);
+    if (sentCount == -1) {
+        if (errno == EWOULDBLOCK) {
+            return 0;
+        }
+        return -1;
+    }
+
+    for (int32_t i = 0; i < sentCount; i++) {
+        pMessages[i].sentLength = msgHdrs[i].msg_len;
+    }
+
+    return sentCount;
+#else
+    int32_t sentCount = 0;
+    for (size_t i = 0; i < count; i++) {
+        int32_t sentLength = hnet_socket_send(socket, pMessages[i].addr, pMessages[i].buffers, pMessages[i].bufferCount);
+        if (sentLength < 0) {
+            return sentCount > 0 ? sentCount : -1;
+        }
+        if (sentLength == 0) {
+            break;
+        }
+        pMessages[i].sentLength = sentLength;
+        sentCount++;
+    }
+    return sentCount;
+#endif
+}
+
 int32_t hnet_socket_recv(HNetSocket socket, HNetAddr& addr, HNetBuffer* pBuffers, size_t bufferCount)
 {
     msghdr msgHdr{};
-    sockaddr_in sin{};
+    HNetSockAddr sockAddr{};
 
-    msgHdr.msg_name = &sin;
-    msgHdr.msg_namelen = sizeof(sockaddr_in);
+    msgHdr.msg_name = &sockAddr;
+    msgHdr.msg_namelen = sizeof(sockAddr);
     msgHdr.msg_iov = reinterpret_cast<iovec*>(pBuffers);
     msgHdr.msg_iovlen = bufferCount;
 
@@ -200,7 +368,54 @@ int32_t hnet_socket_recv(HNetSocket socket, HNetAddr& addr, HNetBuffer* pBuffers
         return -1;
     }
 
-    addr.host = static_cast<uint32_t>(sin.sin_addr.s_addr);
-    addr.port = HNET_NET_TO_HOST_16(sin.sin_port);
+    hnet_address_from_sockaddr(sockAddr, addr);
     return recvLength;
 }
+
+int32_t hnet_socket_recv_batch(HNetSocket socket, HNetAddr* pAddrs, HNetBuffer* pBuffers, size_t* pRecvLengths, size_t count)
+{
+    if (count > HNET_SOCKET_MAX_BATCH_SIZE) {
+        count = HNET_SOCKET_MAX_BATCH_SIZE;
+    }
+
+#if defined(__linux__)
+    mmsghdr msgHdrs[HNET_SOCKET_MAX_BATCH_SIZE];
+    HNetSockAddr sockAddrs[HNET_SOCKET_MAX_BATCH_SIZE];
+
+    for (size_t i = 0; i < count; i++) {
+        msghdr& msgHdr = msgHdrs[i].msg_hdr;
+        msgHdr = {};
+        msgHdr.msg_name = &sockAddrs[i];
+        msgHdr.msg_namelen = sizeof(HNetSockAddr);
+        msgHdr.msg_iov = reinterpret_cast<iovec*>(&pBuffers[i]);
+        msgHdr.msg_iovlen = 1;
+        msgHdrs[i].msg_len = 0;
+    }
+
+    int32_t recvCount = recvmmsg(socket, msgHdrs, count, MSG_NOSIGNAL, nullptr);
+    if (recvCount == -1) {
+        if (errno == EWOULDBLOCK) {
+            return 0;
+        }
+        return -1;
+    }
+
+    for (int32_t i = 0; i < recvCount; i++) {
+        pRecvLengths[i] = (msgHdrs[i].msg_hdr.msg_flags & MSG_TRUNC) ? 0 : msgHdrs[i].msg_len;
+        hnet_address_from_sockaddr(sockAddrs[i], pAddrs[i]);
+    }
+
+    return recvCount;
+#else
+    int32_t recvCount = 0;
+    for (size_t i = 0; i < count; i++) {
+        int32_t recvLength = hnet_socket_recv(socket, pAddrs[i], &pBuffers[i], 1);
+        if (recvLength == 0) {
+            break;
+        }
+        pRecvLengths[i] = recvLength < 0 ? 0 : recvLength;
+        recvCount++;
+    }
+    return recvCount;
+#endif
+}
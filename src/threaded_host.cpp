@@ -0,0 +1,183 @@
+#include "packet.h"
+#include "peer.h"
+#include "threaded_host.h"
+
+static HNetPeer* hnet_threaded_host_find_peer(HNetHost& host, const HNetThreadedCommand& cmd)
+{
+    HNetPeer& peer = host.peers[cmd.peerId >> host.shardBits];
+    if (peer.connectId != cmd.connectId || (peer.state != HNetPeerState::Connected && peer.state != HNetPeerState::DisconnectLater)) {
+        return nullptr;
+    }
+    return &peer;
+}
+
+static void hnet_threaded_host_apply(HNetHost& host, const HNetThreadedCommand& cmd)
+{
+    HNetPeer* pPeer = hnet_threaded_host_find_peer(host, cmd);
+    switch (cmd.type) {
+    case HNetThreadedCommandType::Send:
+        if ((pPeer == nullptr || !hnet_peer_send(*pPeer, cmd.channelId, *cmd.packet)) && cmd.packet->refCount == 0) {
+            hnet_packet_destroy(cmd.packet);
+        }
+        break;
+    case HNetThreadedCommandType::Disconnect:
+        if (pPeer != nullptr) {
+            hnet_peer_disconnect(*pPeer, cmd.data);
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+static void hnet_threaded_host_run(HNetShardWorker& worker)
+{
+    HNetHost& host = *worker.host;
+    uint32_t waitTime = host.wakeup != HNET_SOCKET_NULL ? HNET_THREADED_HOST_WAIT_MSEC : HNET_THREADED_HOST_POLL_MSEC;
+    HNetThreadedCommand cmd;
+    HNetEvent event;
+    bool hasEvent = false;
+
+    while (!worker.stop.load(std::memory_order_relaxed)) {
+        while (hnet_ring_pop(worker.commands, cmd)) {
+            hnet_threaded_host_apply(host, cmd);
+        }
+
+        if (hasEvent && !hnet_ring_push(worker.events, event)) {
+            // the application is behind: keep sending, but leave new events queued in the host
+            hnet_host_flush(host);
+            std::this_thread::yield();
+            continue;
+        }
+
+        hasEvent = hnet_host_service(host, event, waitTime) > 0;
+    }
+
+    if (hasEvent && event.type == HNetEventType::Receive) {
+        hnet_packet_destroy(event.packet);
+    }
+    while (hnet_ring_pop(worker.commands, cmd)) {
+        if (cmd.type == HNetThreadedCommandType::Send) {
+            hnet_packet_destroy(cmd.packet);
+        }
+    }
+    hnet_packet_detach_pools();
+}
+
+bool hnet_threaded_host_initialize(HNetThreadedHost& host, HNetAddr& addr, size_t shardCount, size_t peerCount, size_t channelLimit, uint32_t incomingBandwidth, uint32_t outgoingBandwidth)
+{
+    if (shardCount == 0) {
+        return false;
+    }
+
+    HNetHost* pHosts = new HNetHost[shardCount]{};
+    bool initialized = false;
+    if (shardCount == 1) {
+        initialized = hnet_host_initialize(pHosts[0], &addr, peerCount, channelLimit, incomingBandwidth, outgoingBandwidth);
+        addr.port = pHosts[0].addr.port;
+    } else {
+        initialized = hnet_host_initialize_shards(pHosts, shardCount, addr, peerCount, channelLimit, incomingBandwidth, outgoingBandwidth);
+    }
+    if (!initialized) {
+        delete[] pHosts;
+        return false;
+    }
+
+    HNetShardWorker* pWorkers = new HNetShardWorker[shardCount];
+    for (size_t i = 0; i < shardCount; i++) {
+        HNetShardWorker& worker = pWorkers[i];
+        if (!hnet_ring_initialize(worker.events, HNET_THREADED_HOST_EVENT_RING_SIZE) ||
+            !hnet_ring_initialize(worker.commands, HNET_THREADED_HOST_COMMAND_RING_SIZE)) {
+            for (size_t j = 0; j <= i; j++) {
+                hnet_ring_finalize(pWorkers[j].events);
+                hnet_ring_finalize(pWorkers[j].commands);
+            }
+            for (size_t j = 0; j < shardCount; j++) {
+                hnet_host_finalize(pHosts[j]);
+            }
+            delete[] pWorkers;
+            delete[] pHosts;
+            return false;
+        }
+        worker.host = &pHosts[i];
+        worker.stop.store(false, std::memory_order_relaxed);
+        hnet_host_enable_wakeup(pHosts[i]);
+    }
+
+    // the hosts belong to the workers from here on
+    for (size_t i = 0; i < shardCount; i++) {
+        pWorkers[i].thread = std::thread(hnet_threaded_host_run, std::ref(pWorkers[i]));
+    }
+
+    host.hosts = pHosts;
+    host.workers = pWorkers;
+    host.shardCount = shardCount;
+    host.nextShard = 0;
+    return true;
+}
+
+void hnet_threaded_host_finalize(HNetThreadedHost& host)
+{
+    for (size_t i = 0; i < host.shardCount; i++) {
+        host.workers[i].stop.store(true, std::memory_order_relaxed);
+        hnet_host_wakeup(host.hosts[i]);
+    }
+
+    // the hosts are finalized here rather than by their workers, so no wakeup can race with closing them
+    for (size_t i = 0; i < host.shardCount; i++) {
+        HNetShardWorker& worker = host.workers[i];
+        worker.thread.join();
+        hnet_host_finalize(host.hosts[i]);
+
+        HNetEvent event;
+        while (hnet_ring_pop(worker.events, event)) {
+            if (event.type == HNetEventType::Receive) {
+                hnet_packet_destroy(event.packet);
+            }
+        }
+        hnet_ring_finalize(worker.events);
+        hnet_ring_finalize(worker.commands);
+    }
+
+    delete[] host.workers;
+    delete[] host.hosts;
+    host.workers = nullptr;
+    host.hosts = nullptr;
+    host.shardCount = 0;
+}
+
+int32_t hnet_threaded_host_service(HNetThreadedHost& host, HNetEvent& event)
+{
+    for (size_t i = 0; i < host.shardCount; i++) {
+        HNetShardWorker& worker = host.workers[host.nextShard];
+        if (++host.nextShard == host.shardCount) {
+            host.nextShard = 0;
+        }
+        if (hnet_ring_pop(worker.events, event)) {
+            return 1;
+        }
+    }
+
+    event.type = HNetEventType::None;
+    return 0;
+}
+
+bool hnet_threaded_host_send(HNetThreadedHost& host, HNetPeer& peer, uint32_t connectId, uint8_t channelId, HNetPacket& packet)
+{
+    HNetThreadedCommand cmd{HNetThreadedCommandType::Send, channelId, peer.incomingPeerId, connectId, 0, &packet};
+    if (!hnet_ring_push(host.workers[peer.host - host.hosts].commands, cmd)) {
+        return false;
+    }
+    hnet_host_wakeup(*peer.host);
+    return true;
+}
+
+bool hnet_threaded_host_disconnect(HNetThreadedHost& host, HNetPeer& peer, uint32_t connectId, uint32_t data)
+{
+    HNetThreadedCommand cmd{HNetThreadedCommandType::Disconnect, 0, peer.incomingPeerId, connectId, data, nullptr};
+    if (!hnet_ring_push(host.workers[peer.host - host.hosts].commands, cmd)) {
+        return false;
+    }
+    hnet_host_wakeup(*peer.host);
+    return true;
+}
@@ -0,0 +1,86 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "allocator.h"
+#include "bench_util.h"
+
+#define BENCH_PORT          20203
+#define BENCH_MESSAGE_COUNT 10000
+#define BENCH_WARMUP_COUNT  1000
+#define BENCH_BURST_SIZE    32
+#define BENCH_TIMEOUT_MSEC  10000
+
+static size_t allocationCount = 0;
+
+static void* counting_malloc(size_t size)
+{
+    allocationCount++;
+    return malloc(size);
+}
+
+static bool send(Bench& bench, uint8_t* pData, size_t messageSize, uint32_t flags, size_t messageCount)
+{
+    bench.recvMessages = 0;
+    size_t sentMessages = 0;
+    while (sentMessages < messageCount && !bench.disconnected) {
+        for (size_t i = 0; i < BENCH_BURST_SIZE && sentMessages < messageCount; i++, sentMessages++) {
+            HNetPacket* pPacket = hnet_packet_create(pData, messageSize, flags);
+            if (pPacket == nullptr || !hnet_peer_send(*bench.pClientPeer, 0, *pPacket)) {
+                hnet_packet_destroy(pPacket);
+                return false;
+            }
+        }
+        for (size_t spin = 0; bench.recvMessages < sentMessages && spin < 100000 && !bench.disconnected; spin++) {
+            service(bench, bench.client);
+            service(bench, bench.server);
+        }
+        if (bench.recvMessages < sentMessages && (flags & HNET_PACKET_FLAG_RELIABLE)) {
+            return false;
+        }
+        bench.recvMessages = sentMessages;
+    }
+    return !bench.disconnected;
+}
+
+static void run(Bench& bench, size_t messageSize, uint32_t flags, const char* pName)
+{
+    uint8_t* pData = new uint8_t[messageSize];
+    for (size_t i = 0; i < messageSize; i++) {
+        pData[i] = static_cast<uint8_t>(i);
+    }
+
+    send(bench, pData, messageSize, flags, BENCH_WARMUP_COUNT);
+    allocationCount = 0;
+    bool ok = send(bench, pData, messageSize, flags, BENCH_MESSAGE_COUNT);
+    printf("%-10s %6zu bytes: %6.3f allocations/message%s\n",
+        pName,
+        messageSize,
+        static_cast<double>(allocationCount) / BENCH_MESSAGE_COUNT,
+        ok ? "" : " (failed)");
+
+    delete[] pData;
+}
+
+int main()
+{
+    HNetAllocator callbacks{counting_malloc, free, abort};
+    hnet_allocator_set(callbacks);
+    if (!hnet_initialize()) {
+        return 1;
+    }
+
+    Bench bench{};
+    if (connect(bench, BENCH_PORT, BENCH_TIMEOUT_MSEC)) {
+        const size_t sizes[] = {16, 200, 1000, 4000, 16000};
+        for (size_t messageSize : sizes) {
+            run(bench, messageSize, HNET_PACKET_FLAG_RELIABLE, "reliable");
+            run(bench, messageSize, 0, "unreliable");
+        }
+        hnet_host_finalize(bench.client);
+        hnet_host_finalize(bench.server);
+    } else {
+        printf("failed to connect\n");
+    }
+
+    hnet_finalize();
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,154 @@
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <stdio.h>
+#include <thread>
+#include <vector>
+#include "event.h"
+#include "hnet.h"
+#include "packet.h"
+#include "peer.h"
+
+#define BENCH_PORT          20207
+#define BENCH_THREADS       16
+#define BENCH_MESSAGES      20000
+#define BENCH_MESSAGE_SIZE  32
+#define BENCH_TIMEOUT_MSEC  10000
+
+struct Bench
+{
+    HNetHost server;
+    HNetHost client;
+    HNetPeer* pClientPeer;
+    uint32_t connectId;
+    bool connected;
+    std::mutex mutex;
+    std::vector<HNetPacket*> lockedQueue;
+    std::atomic<size_t> producersDone;
+};
+
+static uint64_t now_usec()
+{
+    using namespace std::chrono;
+    return duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+static size_t service(HNetHost& host, Bench& bench)
+{
+    size_t recvMessages = 0;
+    HNetEvent event;
+    while (hnet_host_service(host, event) > 0) {
+        if (event.type == HNetEventType::Connect) {
+            bench.connected = true;
+        } else if (event.type == HNetEventType::Receive) {
+            recvMessages++;
+            hnet_packet_destroy(event.packet);
+        }
+    }
+    return recvMessages;
+}
+
+static void produce(Bench& bench, bool async)
+{
+    uint8_t data[BENCH_MESSAGE_SIZE] = {};
+    for (size_t i = 0; i < BENCH_MESSAGES; i++) {
+        HNetPacket* pPacket = hnet_packet_create(data, sizeof(data), HNET_PACKET_FLAG_UNSEQUENCED);
+        if (async) {
+            while (!hnet_peer_send_async(*bench.pClientPeer, bench.connectId, 0, *pPacket)) {
+                std::this_thread::yield();
+            }
+        } else {
+            std::lock_guard<std::mutex> lock(bench.mutex);
+            bench.lockedQueue.push_back(pPacket);
+        }
+    }
+    bench.producersDone.fetch_add(1, std::memory_order_release);
+    hnet_packet_detach_pools();
+}
+
+static void run(Bench& bench, bool async)
+{
+    std::vector<HNetPacket*> drained;
+    std::thread producers[BENCH_THREADS];
+    size_t recvMessages = 0;
+    bench.producersDone = 0;
+
+    uint64_t start = now_usec();
+    for (size_t i = 0; i < BENCH_THREADS; i++) {
+        producers[i] = std::thread(produce, std::ref(bench), async);
+    }
+
+    uint64_t produceTime = 0;
+    while (now_usec() - start < BENCH_TIMEOUT_MSEC * 1000) {
+        bool done = bench.producersDone.load(std::memory_order_acquire) == BENCH_THREADS;
+        if (done && produceTime == 0) {
+            produceTime = now_usec() - start;
+        }
+        if (!async) {
+            {
+                std::lock_guard<std::mutex> lock(bench.mutex);
+                drained.swap(bench.lockedQueue);
+            }
+            for (HNetPacket* pPacket : drained) {
+                if (!hnet_peer_send(*bench.pClientPeer, 0, *pPacket)) {
+                    hnet_packet_destroy(pPacket);
+                }
+            }
+            drained.clear();
+        }
+        service(bench.client, bench);
+        recvMessages += service(bench.server, bench);
+        if (done && (async || bench.lockedQueue.empty()) && hnet_mpsc_ring_empty(bench.client.asyncSends) && bench.client.sendQueue.empty()) {
+            break;
+        }
+    }
+    uint64_t elapsed = now_usec() - start;
+
+    for (size_t i = 0; i < BENCH_THREADS; i++) {
+        producers[i].join();
+    }
+    recvMessages += service(bench.server, bench);
+
+    double messages = static_cast<double>(BENCH_THREADS) * BENCH_MESSAGES;
+    printf("%-8s %2d threads: produced %6.2f M msgs/s, sent %6.2f M msgs/s, %zu received\n",
+        async ? "async" : "mutex",
+        BENCH_THREADS,
+        produceTime > 0 ? messages / produceTime : 0.0,
+        messages / elapsed,
+        recvMessages);
+}
+
+int main()
+{
+    if (!hnet_initialize()) {
+        return 1;
+    }
+
+    Bench bench{};
+    HNetAddr addr{};
+    if (!hnet_host_get_addr("127.0.0.1", BENCH_PORT, addr) ||
+        !hnet_host_initialize(bench.server, &addr, 1, 1, 0, 0) ||
+        !hnet_host_initialize(bench.client, nullptr, 1, 1, 0, 0)) {
+        return 1;
+    }
+
+    bench.pClientPeer = hnet_host_connect(bench.client, addr, 1, 0);
+    bench.connectId = bench.pClientPeer->connectId;
+    uint64_t start = now_usec();
+    while (!bench.connected && now_usec() - start < BENCH_TIMEOUT_MSEC * 1000) {
+        service(bench.client, bench);
+        service(bench.server, bench);
+    }
+
+    if (bench.connected) {
+        run(bench, false);
+        run(bench, true);
+    } else {
+        printf("failed to connect\n");
+    }
+
+    hnet_host_finalize(bench.client);
+    hnet_host_finalize(bench.server);
+    hnet_finalize();
+    return 0;
+}
@@ -0,0 +1,158 @@
+#include <chrono>
+#include <stdio.h>
+#include "event.h"
+#include "hnet.h"
+#include "packet.h"
+#include "peer.h"
+
+#define BENCH_PORT         20208
+#define BENCH_CLIENTS      32
+#define BENCH_BURST        32
+#define BENCH_ROUNDS       200
+#define BENCH_MESSAGE_SIZE 32
+#define BENCH_BATCH_SIZE   256
+#define BENCH_TIMEOUT_MSEC 10000
+
+struct Bench
+{
+    HNetHost server;
+    HNetHost clients[BENCH_CLIENTS];
+    HNetPeer* pPeers[BENCH_CLIENTS];
+    size_t connected;
+};
+
+static uint64_t now_usec()
+{
+    using namespace std::chrono;
+    return duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+static size_t handle(Bench& bench, const HNetEvent& event)
+{
+    switch (event.type) {
+    case HNetEventType::Connect:
+        bench.connected++;
+        break;
+    case HNetEventType::Receive:
+        hnet_packet_destroy(event.packet);
+        return 1;
+    default:
+        break;
+    }
+    return 0;
+}
+
+// drains everything the server has received, returning the number of messages
+static size_t drain(Bench& bench, size_t batchSize, size_t& calls)
+{
+    size_t recvMessages = 0;
+    if (batchSize == 1) {
+        HNetEvent event;
+        for (calls++; hnet_host_service(bench.server, event) > 0; calls++) {
+            recvMessages += handle(bench, event);
+        }
+        return recvMessages;
+    }
+
+    HNetEvent events[BENCH_BATCH_SIZE];
+    for (;;) {
+        calls++;
+        int32_t eventCount = hnet_host_service_batch(bench.server, events, batchSize);
+        for (int32_t i = 0; i < eventCount; i++) {
+            recvMessages += handle(bench, events[i]);
+        }
+        if (eventCount <= 0) {
+            return recvMessages;
+        }
+    }
+}
+
+static void service_clients(Bench& bench)
+{
+    for (size_t i = 0; i < BENCH_CLIENTS; i++) {
+        HNetEvent event;
+        while (hnet_host_service(bench.clients[i], event) > 0) {
+            if (event.type == HNetEventType::Receive) {
+                hnet_packet_destroy(event.packet);
+            }
+        }
+    }
+}
+
+static void run(Bench& bench, size_t batchSize)
+{
+    uint8_t data[BENCH_MESSAGE_SIZE] = {};
+    size_t recvMessages = 0;
+    size_t calls = 0;
+    uint64_t drainTime = 0;
+
+    for (size_t round = 0; round < BENCH_ROUNDS; round++) {
+        for (size_t i = 0; i < BENCH_CLIENTS; i++) {
+            for (size_t j = 0; j < BENCH_BURST; j++) {
+                HNetPacket* pPacket = hnet_packet_create(data, sizeof(data), HNET_PACKET_FLAG_RELIABLE);
+                if (pPacket != nullptr && !hnet_peer_send(*bench.pPeers[i], 0, *pPacket)) {
+                    hnet_packet_destroy(pPacket);
+                }
+            }
+        }
+        service_clients(bench);
+
+        uint64_t start = now_usec();
+        recvMessages += drain(bench, batchSize, calls);
+        drainTime += now_usec() - start;
+    }
+
+    // let the last acks through so the next run starts from empty windows
+    for (size_t i = 0; i < 10; i++) {
+        service_clients(bench);
+        size_t unused = 0;
+        recvMessages += drain(bench, batchSize, unused);
+    }
+
+    printf("batch %3zu: %8.3f us/message, %7zu service calls for %7zu messages\n",
+        batchSize,
+        recvMessages > 0 ? static_cast<double>(drainTime) / recvMessages : 0.0,
+        calls,
+        recvMessages);
+}
+
+int main()
+{
+    if (!hnet_initialize()) {
+        return 1;
+    }
+
+    static Bench bench{};
+    HNetAddr addr{};
+    if (!hnet_host_get_addr("127.0.0.1", BENCH_PORT, addr) ||
+        !hnet_host_initialize(bench.server, &addr, BENCH_CLIENTS, 1, 0, 0)) {
+        return 1;
+    }
+    for (size_t i = 0; i < BENCH_CLIENTS; i++) {
+        hnet_host_initialize(bench.clients[i], nullptr, 1, 1, 0, 0);
+        bench.pPeers[i] = hnet_host_connect(bench.clients[i], addr, 1, 0);
+    }
+
+    uint64_t start = now_usec();
+    while (bench.connected < BENCH_CLIENTS && now_usec() - start < BENCH_TIMEOUT_MSEC * 1000) {
+        service_clients(bench);
+        size_t calls = 0;
+        drain(bench, 1, calls);
+    }
+
+    if (bench.connected == BENCH_CLIENTS) {
+        static const size_t batchSizes[] = {1, 16, BENCH_BATCH_SIZE};
+        for (size_t batchSize : batchSizes) {
+            run(bench, batchSize);
+        }
+    } else {
+        printf("failed to connect\n");
+    }
+
+    for (size_t i = 0; i < BENCH_CLIENTS; i++) {
+        hnet_host_finalize(bench.clients[i]);
+    }
+    hnet_host_finalize(bench.server);
+    hnet_finalize();
+    return 0;
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <chrono>
+#include <stdint.h>
+#include "event.h"
+#include "hnet.h"
+#include "packet.h"
+#include "peer.h"
+
+// a server and a client host on loopback joined by one peer, shared by the single-connection benches
+struct Bench
+{
+    HNetHost server;
+    HNetHost client;
+    HNetPeer* pServerPeer;
+    HNetPeer* pClientPeer;
+    size_t recvBytes;
+    size_t recvMessages;
+    bool disconnected;
+};
+
+inline uint64_t now_msec()
+{
+    using namespace std::chrono;
+    return duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+inline void service(Bench& bench, HNetHost& host)
+{
+    HNetEvent event;
+    while (hnet_host_service(host, event) > 0) {
+        switch (event.type) {
+        case HNetEventType::Connect:
+            if (&host == &bench.server) {
+                bench.pServerPeer = event.peer;
+            }
+            break;
+        case HNetEventType::Disconnect:
+            bench.disconnected = true;
+            break;
+        case HNetEventType::Receive:
+            bench.recvBytes += event.packet->dataLength;
+            bench.recvMessages++;
+            hnet_packet_destroy(event.packet);
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+inline bool connect(Bench& bench, uint16_t port, uint64_t timeoutMsec)
+{
+    HNetAddr addr{};
+    if (!hnet_host_get_addr("127.0.0.1", port, addr)) {
+        return false;
+    }
+    if (!hnet_host_initialize(bench.server, &addr, 1, 1, 0, 0)) {
+        return false;
+    }
+    if (!hnet_host_initialize(bench.client, nullptr, 1, 1, 0, 0)) {
+        hnet_host_finalize(bench.server);
+        return false;
+    }
+
+    bench.pClientPeer = hnet_host_connect(bench.client, addr, 1, 0);
+    uint64_t start = now_msec();
+    while (bench.pClientPeer != nullptr && bench.pServerPeer == nullptr && now_msec() - start < timeoutMsec) {
+        service(bench, bench.client);
+        service(bench, bench.server);
+    }
+    return bench.pServerPeer != nullptr;
+}
@@ -0,0 +1,85 @@
+#include <algorithm>
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include "checksum.h"
+#include "hnet.h"
+#include "socket.h"
+
+#define BENCH_TOTAL_BYTES   (256 * 1024 * 1024)
+#define BENCH_FRAGMENT_SIZE 100
+#define BENCH_MAX_SIZE      (64 * 1024)
+
+static const char* const s_implNames[] = {"slicing8", "sse4.2", "pclmul"};
+
+static uint64_t now_usec()
+{
+    using namespace std::chrono;
+    return duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+static void run(HNetCrc32cImpl impl, const uint8_t* pData, size_t size, bool scattered)
+{
+    // a scattered datagram reaches the checksum as the command/payload iovecs it was built from
+    HNetBuffer buffers[BENCH_MAX_SIZE / BENCH_FRAGMENT_SIZE + 1];
+    size_t bufferCount = 0;
+    size_t step = scattered ? BENCH_FRAGMENT_SIZE : size;
+    for (size_t offset = 0; offset < size; offset += step) {
+        buffers[bufferCount].data = const_cast<uint8_t*>(pData + offset);
+        buffers[bufferCount].dataLength = std::min(step, size - offset);
+        bufferCount++;
+    }
+
+    size_t iterations = BENCH_TOTAL_BYTES / size;
+    uint32_t checksum = 0;
+    uint64_t start = now_usec();
+    for (size_t i = 0; i < iterations; i++) {
+        checksum = hnet_crc32c_with(impl, buffers, bufferCount);
+    }
+    uint64_t elapsed = now_usec() - start;
+    if (elapsed == 0) {
+        elapsed = 1;
+    }
+
+    printf("%-9s %6zu bytes%s: %6.2f GB/s (%08x)\n",
+        s_implNames[static_cast<size_t>(impl)],
+        size,
+        scattered ? " scattered" : "          ",
+        static_cast<double>(size) * iterations / (1024.0 * 1024.0 * 1024.0) / (elapsed / 1000000.0),
+        checksum);
+}
+
+int main()
+{
+    if (!hnet_initialize()) {
+        return 1;
+    }
+
+    HNetBuffer check{const_cast<char*>("123456789"), 9};
+    uint8_t* pData = new uint8_t[BENCH_MAX_SIZE];
+    for (size_t i = 0; i < BENCH_MAX_SIZE; i++) {
+        pData[i] = static_cast<uint8_t>(rand());
+    }
+
+    static const size_t sizes[] = {64, 512, 1400, 16 * 1024, BENCH_MAX_SIZE};
+    for (size_t impl = 0; impl < sizeof(s_implNames) / sizeof(s_implNames[0]); impl++) {
+        HNetCrc32cImpl crcImpl = static_cast<HNetCrc32cImpl>(impl);
+        if (!hnet_crc32c_supported(crcImpl)) {
+            printf("%-9s not supported\n", s_implNames[impl]);
+            continue;
+        }
+        if (HNET_NET_TO_HOST_32(hnet_crc32c_with(crcImpl, &check, 1)) != 0xE3069283) {
+            printf("%-9s MISMATCH\n", s_implNames[impl]);
+            continue;
+        }
+        for (size_t size : sizes) {
+            run(crcImpl, pData, size, false);
+        }
+        run(crcImpl, pData, 1400, true);
+    }
+    printf("default: %s\n", s_implNames[static_cast<size_t>(hnet_crc32c_best_impl())]);
+
+    delete[] pData;
+    hnet_finalize();
+    return 0;
+}
@@ -1,25 +1,21 @@
-#include <time.h>
 #include "hnet.h"
+#include "hnet_time.h"
 
-static void sleep()
-{
-    timespec time{};
-    time.tv_nsec = 1000000;
-    nanosleep(&time, nullptr);
-}
+#define SEND_INTERVAL 100
 
 static void run()
 {
     HNetClient* pClient = HNetClient::create();
     if (pClient != nullptr) {
         pClient->connect("127.0.0.1", 20201);
-        for (uint32_t counter = 0;; counter++) {
-            pClient->update();
-            sleep();
-            if (counter == 100) {
+        uint64_t nextSendTime = hnet_time_now_msec() + SEND_INTERVAL;
+        for (;;) {
+            uint64_t now = hnet_time_now_msec();
+            if (now >= nextSendTime) {
                 pClient->sendPacket();
-                counter = 0;
+                nextSendTime = now + SEND_INTERVAL;
             }
+            pClient->update(static_cast<uint32_t>(nextSendTime - now));
         }
         HNetClient::destroy(pClient);
     }
@@ -0,0 +1,111 @@
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include "compressor.h"
+#include "hnet.h"
+
+#define BENCH_DATAGRAM_SIZE 1400
+#define BENCH_FRAGMENT_SIZE 100
+#define BENCH_ITERATIONS    20000
+
+struct Snapshot
+{
+    uint32_t entityId;
+    float position[3];
+    float velocity[3];
+    uint16_t health;
+    uint16_t flags;
+};
+
+static uint64_t now_usec()
+{
+    using namespace std::chrono;
+    return duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+static void fill_snapshots(uint8_t* pData, size_t size)
+{
+    for (size_t i = 0; i + sizeof(Snapshot) <= size; i += sizeof(Snapshot)) {
+        size_t index = i / sizeof(Snapshot);
+        Snapshot snapshot{};
+        snapshot.entityId = 1000 + static_cast<uint32_t>(index);
+        snapshot.position[0] = 10.0f + index * 0.5f;
+        snapshot.position[1] = 0.0f;
+        snapshot.position[2] = -4.0f + index * 0.25f;
+        snapshot.velocity[0] = 1.0f;
+        snapshot.health = 100;
+        memcpy(pData + i, &snapshot, sizeof(snapshot));
+    }
+}
+
+static void fill_text(uint8_t* pData, size_t size)
+{
+    static const char text[] = "{\"type\":\"chat\",\"channel\":\"global\",\"from\":\"player\",\"message\":\"hello world\"},";
+    for (size_t i = 0; i < size; i++) {
+        pData[i] = static_cast<uint8_t>(text[i % (sizeof(text) - 1)]);
+    }
+}
+
+static void fill_random(uint8_t* pData, size_t size)
+{
+    for (size_t i = 0; i < size; i++) {
+        pData[i] = static_cast<uint8_t>(rand());
+    }
+}
+
+static void run(const char* pName, void (*fill)(uint8_t*, size_t))
+{
+    uint8_t data[BENCH_DATAGRAM_SIZE] = {};
+    fill(data, sizeof(data));
+
+    // a datagram reaches the compressor as the command/payload iovecs it was built from
+    HNetBuffer buffers[BENCH_DATAGRAM_SIZE / BENCH_FRAGMENT_SIZE];
+    for (size_t i = 0; i < sizeof(buffers) / sizeof(buffers[0]); i++) {
+        buffers[i].data = data + i * BENCH_FRAGMENT_SIZE;
+        buffers[i].dataLength = BENCH_FRAGMENT_SIZE;
+    }
+
+    void* pContext = hnet_lz_create();
+    uint8_t compressed[BENCH_DATAGRAM_SIZE];
+    uint8_t decompressed[BENCH_DATAGRAM_SIZE];
+    size_t compressedSize = 0;
+
+    uint64_t start = now_usec();
+    for (size_t i = 0; i < BENCH_ITERATIONS; i++) {
+        compressedSize = hnet_lz_compress(pContext, buffers, sizeof(buffers) / sizeof(buffers[0]), sizeof(data), compressed, sizeof(compressed));
+    }
+    uint64_t compressTime = now_usec() - start;
+
+    size_t decompressedSize = 0;
+    start = now_usec();
+    for (size_t i = 0; i < BENCH_ITERATIONS && compressedSize > 0; i++) {
+        decompressedSize = hnet_lz_decompress(pContext, compressed, compressedSize, decompressed, sizeof(decompressed));
+    }
+    uint64_t decompressTime = now_usec() - start;
+
+    bool valid = compressedSize == 0 || (decompressedSize == sizeof(data) && memcmp(data, decompressed, sizeof(data)) == 0);
+    double megabytes = static_cast<double>(sizeof(data)) * BENCH_ITERATIONS / (1024.0 * 1024.0);
+    printf("%-10s ratio %5.3f, compress %7.1f MB/s (%5.2f us/datagram), decompress %7.1f MB/s%s\n",
+        pName,
+        compressedSize > 0 ? static_cast<double>(compressedSize) / sizeof(data) : 1.0,
+        megabytes / (compressTime / 1000000.0),
+        static_cast<double>(compressTime) / BENCH_ITERATIONS,
+        compressedSize > 0 ? megabytes / (decompressTime / 1000000.0) : 0.0,
+        !valid ? " (MISMATCH)" : compressedSize == 0 ? " (sent uncompressed)" : "");
+
+    hnet_lz_destroy(pContext);
+}
+
+int main()
+{
+    if (!hnet_initialize()) {
+        return 1;
+    }
+
+    run("snapshots", fill_snapshots);
+    run("text", fill_text);
+    run("random", fill_random);
+
+    hnet_finalize();
+    return 0;
+}
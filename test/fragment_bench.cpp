@@ -0,0 +1,81 @@
+#include <stdio.h>
+#include "bench_util.h"
+
+#define BENCH_PORT         20202
+#define BENCH_TOTAL_BYTES  (64 * 1024 * 1024)
+#define BENCH_TIMEOUT_MSEC 60000
+
+static bool run(Bench& bench, size_t messageSize)
+{
+    size_t messageCount = BENCH_TOTAL_BYTES / messageSize;
+    if (messageCount == 0) {
+        messageCount = 1;
+    }
+
+    uint8_t* pData = new uint8_t[messageSize];
+    for (size_t i = 0; i < messageSize; i++) {
+        pData[i] = static_cast<uint8_t>(i);
+    }
+
+    bench.recvBytes = 0;
+    bench.recvMessages = 0;
+    uint32_t ackStart = bench.server.totalSentData;
+    uint64_t start = now_msec();
+    bool timedOut = false;
+
+    for (size_t i = 0; i < messageCount && !timedOut; i++) {
+        HNetPacket* pPacket = hnet_packet_create(pData, messageSize, HNET_PACKET_FLAG_RELIABLE);
+        if (pPacket == nullptr || !hnet_peer_send(*bench.pClientPeer, 0, *pPacket)) {
+            hnet_packet_destroy(pPacket);
+            timedOut = true;
+            break;
+        }
+        while (bench.recvMessages <= i) {
+            service(bench, bench.client);
+            service(bench, bench.server);
+            if (bench.disconnected || now_msec() - start >= BENCH_TIMEOUT_MSEC) {
+                timedOut = true;
+                break;
+            }
+        }
+    }
+
+    uint64_t elapsed = now_msec() - start;
+    if (elapsed == 0) {
+        elapsed = 1;
+    }
+    // the receiver only sends acks and pings back, so its output is the ack overhead
+    double recvMBytes = static_cast<double>(bench.recvBytes) / (1024.0 * 1024.0);
+    printf("%10zu bytes x %5zu: %8.2f MB/s %8.0f ack bytes/MB%s\n",
+        messageSize,
+        bench.recvMessages,
+        recvMBytes / (elapsed / 1000.0),
+        recvMBytes > 0.0 ? (bench.server.totalSentData - ackStart) / recvMBytes : 0.0,
+        bench.disconnected ? " (disconnected)" : timedOut ? " (timed out)" : "");
+
+    delete[] pData;
+    return !bench.disconnected;
+}
+
+int main()
+{
+    if (!hnet_initialize()) {
+        return 1;
+    }
+
+    Bench bench{};
+    if (connect(bench, BENCH_PORT, BENCH_TIMEOUT_MSEC)) {
+        for (size_t messageSize = 64 * 1024; messageSize <= 32 * 1024 * 1024; messageSize *= 2) {
+            if (!run(bench, messageSize)) {
+                break;
+            }
+        }
+        hnet_host_finalize(bench.client);
+        hnet_host_finalize(bench.server);
+    } else {
+        printf("failed to connect\n");
+    }
+
+    hnet_finalize();
+    return 0;
+}
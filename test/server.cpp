@@ -1,24 +1,20 @@
-#include <time.h>
 #include "hnet.h"
+#include "hnet_time.h"
 
-static void sleep()
-{
-    timespec time{};
-    time.tv_nsec = 1000000;
-    nanosleep(&time, nullptr);
-}
+#define SEND_INTERVAL 100
 
 static void run()
 {
     HNetServer* pServer = HNetServer::create("127.0.0.1", 20201, 32);
     if (pServer != nullptr) {
-        for (uint32_t counter = 0;; counter++) {
-            pServer->update();
-            sleep();
-            if (counter == 100) {
+        uint64_t nextSendTime = hnet_time_now_msec() + SEND_INTERVAL;
+        for (;;) {
+            uint64_t now = hnet_time_now_msec();
+            if (now >= nextSendTime) {
                 pServer->sendPacket();
-                counter = 0;
+                nextSendTime = now + SEND_INTERVAL;
             }
+            pServer->update(static_cast<uint32_t>(nextSendTime - now));
         }
         HNetServer::destroy(pServer);
     }
@@ -0,0 +1,163 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <stdio.h>
+#include <thread>
+#include "event.h"
+#include "hnet.h"
+#include "packet.h"
+#include "peer.h"
+
+#define BENCH_PORT          20205
+#define BENCH_CLIENTS       32
+#define BENCH_MAX_SHARDS    8
+#define BENCH_MESSAGE_SIZE  32
+#define BENCH_BURST         16
+#define BENCH_DURATION_MSEC 2000
+#define BENCH_TIMEOUT_MSEC  10000
+
+struct alignas(64) Shard
+{
+    HNetHost* pHost;
+    std::thread thread;
+    std::atomic<uint64_t> recvMessages;
+    std::atomic<uint32_t> peers;
+};
+
+static std::atomic<bool> s_stop;
+
+static uint64_t now_msec()
+{
+    using namespace std::chrono;
+    return duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+// each shard's host lives and dies on its own thread, packets included
+static void service_shard(Shard& shard)
+{
+    HNetEvent event;
+    while (!s_stop.load(std::memory_order_relaxed)) {
+        if (hnet_host_service(*shard.pHost, event, 1) <= 0) {
+            continue;
+        }
+        switch (event.type) {
+        case HNetEventType::Connect:
+            shard.peers.fetch_add(1, std::memory_order_relaxed);
+            break;
+        case HNetEventType::Receive:
+            shard.recvMessages.fetch_add(1, std::memory_order_relaxed);
+            hnet_packet_destroy(event.packet);
+            break;
+        default:
+            break;
+        }
+    }
+    hnet_host_finalize(*shard.pHost);
+    hnet_packet_detach_pools();
+}
+
+static size_t service_clients(HNetHost* pClients)
+{
+    size_t connected = 0;
+    for (size_t i = 0; i < BENCH_CLIENTS; i++) {
+        HNetEvent event;
+        while (hnet_host_service(pClients[i], event) > 0) {
+            if (event.type == HNetEventType::Receive) {
+                hnet_packet_destroy(event.packet);
+            }
+        }
+        connected += pClients[i].connectedPeers;
+    }
+    return connected;
+}
+
+static void run(size_t shardCount)
+{
+    static Shard shards[BENCH_MAX_SHARDS];
+    static HNetHost hosts[BENCH_MAX_SHARDS];
+    static HNetHost clients[BENCH_CLIENTS];
+    HNetPeer* pPeers[BENCH_CLIENTS] = {};
+
+    HNetAddr addr{};
+    if (!hnet_host_get_addr("127.0.0.1", BENCH_PORT, addr)) {
+        return;
+    }
+    bool initialized = shardCount == 1 ?
+        hnet_host_initialize(hosts[0], &addr, BENCH_CLIENTS, 1, 0, 0) :
+        hnet_host_initialize_shards(hosts, shardCount, addr, BENCH_CLIENTS, 1, 0, 0);
+    if (!initialized) {
+        printf("%zu shards: failed to initialize\n", shardCount);
+        return;
+    }
+
+    s_stop = false;
+    for (size_t i = 0; i < shardCount; i++) {
+        shards[i].pHost = &hosts[i];
+        shards[i].recvMessages = 0;
+        shards[i].peers = 0;
+        shards[i].thread = std::thread(service_shard, std::ref(shards[i]));
+    }
+
+    for (size_t i = 0; i < BENCH_CLIENTS; i++) {
+        hnet_host_initialize(clients[i], nullptr, 1, 1, 0, 0);
+        pPeers[i] = hnet_host_connect(clients[i], addr, 1, 0);
+    }
+
+    uint64_t start = now_msec();
+    while (service_clients(clients) < BENCH_CLIENTS && now_msec() - start < BENCH_TIMEOUT_MSEC) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    uint8_t data[BENCH_MESSAGE_SIZE] = {};
+    uint64_t recvStart = 0;
+    for (size_t i = 0; i < shardCount; i++) {
+        recvStart += shards[i].recvMessages;
+    }
+    start = now_msec();
+    while (now_msec() - start < BENCH_DURATION_MSEC) {
+        for (size_t i = 0; i < BENCH_CLIENTS; i++) {
+            for (size_t j = 0; j < BENCH_BURST && pPeers[i]->state == HNetPeerState::Connected; j++) {
+                HNetPacket* pPacket = hnet_packet_create(data, sizeof(data), 0);
+                if (pPacket != nullptr && !hnet_peer_send(*pPeers[i], 0, *pPacket)) {
+                    hnet_packet_destroy(pPacket);
+                }
+            }
+        }
+        service_clients(clients);
+    }
+    uint64_t elapsed = now_msec() - start;
+
+    uint64_t recvMessages = 0;
+    for (size_t i = 0; i < shardCount; i++) {
+        recvMessages += shards[i].recvMessages;
+    }
+    printf("%zu shards: %9.0f packets/s, peers per shard:", shardCount, (recvMessages - recvStart) * 1000.0 / elapsed);
+    for (size_t i = 0; i < shardCount; i++) {
+        printf(" %u", shards[i].peers.load());
+    }
+    printf("\n");
+
+    s_stop = true;
+    for (size_t i = 0; i < shardCount; i++) {
+        shards[i].thread.join();
+    }
+    for (size_t i = 0; i < BENCH_CLIENTS; i++) {
+        hnet_host_finalize(clients[i]);
+    }
+}
+
+int main()
+{
+    if (!hnet_initialize()) {
+        return 1;
+    }
+
+    size_t maxShards = std::thread::hardware_concurrency();
+    printf("%zu hardware threads\n", maxShards);
+    for (size_t shardCount = 1; shardCount <= BENCH_MAX_SHARDS && shardCount <= std::max<size_t>(maxShards, 4); shardCount *= 2) {
+        run(shardCount);
+    }
+
+    hnet_finalize();
+    return 0;
+}
@@ -0,0 +1,143 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <stdio.h>
+#include <thread>
+#include "event.h"
+#include "hnet.h"
+#include "packet.h"
+#include "peer.h"
+#include "threaded_host.h"
+
+#define BENCH_PORT          20206
+#define BENCH_CLIENTS       64
+#define BENCH_MESSAGE_SIZE  32
+#define BENCH_BURST         8
+#define BENCH_DURATION_MSEC 2000
+#define BENCH_TIMEOUT_MSEC  10000
+
+static std::atomic<bool> s_stop;
+static std::atomic<size_t> s_connected;
+
+static uint64_t now_msec()
+{
+    using namespace std::chrono;
+    return duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+// the clients get a thread of their own so the application thread only drains the threaded host
+static void run_clients(HNetAddr addr)
+{
+    static HNetHost clients[BENCH_CLIENTS];
+    HNetPeer* pPeers[BENCH_CLIENTS] = {};
+    for (size_t i = 0; i < BENCH_CLIENTS; i++) {
+        hnet_host_initialize(clients[i], nullptr, 1, 1, 0, 0);
+        pPeers[i] = hnet_host_connect(clients[i], addr, 1, 0);
+    }
+
+    uint8_t data[BENCH_MESSAGE_SIZE] = {};
+    while (!s_stop.load(std::memory_order_relaxed)) {
+        size_t connected = 0;
+        for (size_t i = 0; i < BENCH_CLIENTS; i++) {
+            for (size_t j = 0; j < BENCH_BURST && pPeers[i]->state == HNetPeerState::Connected; j++) {
+                HNetPacket* pPacket = hnet_packet_create(data, sizeof(data), 0);
+                if (pPacket != nullptr && !hnet_peer_send(*pPeers[i], 0, *pPacket)) {
+                    hnet_packet_destroy(pPacket);
+                }
+            }
+            HNetEvent event;
+            while (hnet_host_service(clients[i], event) > 0) {
+                if (event.type == HNetEventType::Receive) {
+                    hnet_packet_destroy(event.packet);
+                }
+            }
+            connected += clients[i].connectedPeers;
+        }
+        s_connected.store(connected, std::memory_order_relaxed);
+    }
+
+    for (size_t i = 0; i < BENCH_CLIENTS; i++) {
+        hnet_host_finalize(clients[i]);
+    }
+    hnet_packet_detach_pools();
+}
+
+static void run(size_t shardCount)
+{
+    HNetAddr addr{};
+    if (!hnet_host_get_addr("127.0.0.1", BENCH_PORT, addr)) {
+        return;
+    }
+    HNetThreadedHost host{};
+    if (!hnet_threaded_host_initialize(host, addr, shardCount, BENCH_CLIENTS, 1, 0, 0)) {
+        printf("%zu shards: failed to initialize\n", shardCount);
+        return;
+    }
+
+    s_stop = false;
+    s_connected = 0;
+    std::thread clientThread(run_clients, addr);
+
+    size_t connects = 0;
+    size_t recvMessages = 0;
+    size_t replies = 0;
+    uint64_t start = now_msec();
+    uint64_t measureStart = 0;
+    while (now_msec() - start < BENCH_TIMEOUT_MSEC + BENCH_DURATION_MSEC) {
+        if (measureStart == 0 && s_connected.load(std::memory_order_relaxed) == BENCH_CLIENTS) {
+            measureStart = now_msec();
+            recvMessages = 0;
+        }
+        if (measureStart != 0 && now_msec() - measureStart >= BENCH_DURATION_MSEC) {
+            break;
+        }
+
+        HNetEvent event;
+        if (hnet_threaded_host_service(host, event) <= 0) {
+            std::this_thread::yield();
+            continue;
+        }
+        switch (event.type) {
+        case HNetEventType::Connect:
+            connects++;
+            break;
+        case HNetEventType::Receive:
+            // echo every 64th message back through the peer's worker
+            if ((++recvMessages & 63) == 0 && hnet_threaded_host_send(host, *event.peer, event.connectId, 0, *event.packet)) {
+                replies++;
+            } else {
+                hnet_packet_destroy(event.packet);
+            }
+            break;
+        default:
+            break;
+        }
+    }
+    uint64_t elapsed = measureStart != 0 ? now_msec() - measureStart : 0;
+
+    printf("%zu shards: %9.0f events/s, %zu connects, %zu replies%s\n",
+        shardCount,
+        elapsed > 0 ? recvMessages * 1000.0 / elapsed : 0.0,
+        connects,
+        replies,
+        measureStart == 0 ? " (timed out)" : "");
+
+    s_stop = true;
+    clientThread.join();
+    hnet_threaded_host_finalize(host);
+}
+
+int main()
+{
+    if (!hnet_initialize()) {
+        return 1;
+    }
+
+    size_t maxShards = std::max<size_t>(std::thread::hardware_concurrency(), 4);
+    for (size_t shardCount = 1; shardCount <= maxShards && shardCount <= 8; shardCount *= 2) {
+        run(shardCount);
+    }
+
+    hnet_finalize();
+    return 0;
+}
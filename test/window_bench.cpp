@@ -0,0 +1,84 @@
+#include <stdio.h>
+#include <thread>
+#include "bench_util.h"
+
+#define BENCH_PORT          20204
+#define BENCH_TOTAL_BYTES   (16 * 1024 * 1024)
+#define BENCH_TIMEOUT_MSEC  60000
+#define BENCH_RECV_INTERVAL 10
+
+// queues everything up front and lets the receiver drain its socket only every BENCH_RECV_INTERVAL ms
+static void run(Bench& bench, size_t messageSize)
+{
+    size_t messageCount = BENCH_TOTAL_BYTES / messageSize;
+    uint8_t* pData = new uint8_t[messageSize];
+    for (size_t i = 0; i < messageSize; i++) {
+        pData[i] = static_cast<uint8_t>(i);
+    }
+
+    bench.recvBytes = 0;
+    bench.recvMessages = 0;
+    uint32_t packetsSent = bench.pClientPeer->packetsSent;
+    uint32_t packetsLost = bench.pClientPeer->packetsLost;
+    uint32_t maxInTransit = 0;
+
+    for (size_t i = 0; i < messageCount; i++) {
+        HNetPacket* pPacket = hnet_packet_create(pData, messageSize, HNET_PACKET_FLAG_RELIABLE);
+        if (pPacket == nullptr || !hnet_peer_send(*bench.pClientPeer, 0, *pPacket)) {
+            hnet_packet_destroy(pPacket);
+            messageCount = i;
+            break;
+        }
+    }
+
+    uint64_t start = now_msec();
+    uint64_t nextRecvTime = start;
+    while (bench.recvMessages < messageCount && !bench.disconnected && now_msec() - start < BENCH_TIMEOUT_MSEC) {
+        service(bench, bench.client);
+        if (bench.pClientPeer->reliableDataInTransit > maxInTransit) {
+            maxInTransit = bench.pClientPeer->reliableDataInTransit;
+        }
+        if (now_msec() >= nextRecvTime) {
+            service(bench, bench.server);
+            nextRecvTime = now_msec() + BENCH_RECV_INTERVAL;
+        } else {
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+    }
+
+    uint64_t elapsed = now_msec() - start;
+    if (elapsed == 0) {
+        elapsed = 1;
+    }
+    printf("%8zu bytes x %6zu: %8.2f MB/s, %7u sent, %6u lost, %7u max bytes in transit%s\n",
+        messageSize,
+        bench.recvMessages,
+        static_cast<double>(bench.recvBytes) / (1024.0 * 1024.0) / (elapsed / 1000.0),
+        bench.pClientPeer->packetsSent - packetsSent,
+        bench.pClientPeer->packetsLost - packetsLost,
+        maxInTransit,
+        bench.disconnected ? " (disconnected)" : bench.recvMessages < messageCount ? " (timed out)" : "");
+
+    delete[] pData;
+}
+
+int main()
+{
+    if (!hnet_initialize()) {
+        return 1;
+    }
+
+    Bench bench{};
+    if (connect(bench, BENCH_PORT, BENCH_TIMEOUT_MSEC)) {
+        for (size_t messageSize = 1024; messageSize <= 64 * 1024 && !bench.disconnected; messageSize *= 8) {
+            run(bench, messageSize);
+        }
+        hnet_host_finalize(bench.client);
+        hnet_host_finalize(bench.server);
+    } else {
+        printf("failed to connect\n");
+    }
+
+    hnet_finalize();
+    return 0;
+}